@@ -0,0 +1,509 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include "gif.h"
+
+// Decode benchmark. Each case runs in a child process, which reads a GIF
+// from a process of its own generating it with the encoder and checking it
+// decodes back to the frames painted. The child then decodes it over and over
+// through GIF_ProcessStream(). The resident size reported is how far its peak
+// grew over what it held with the GIF read, so it is that of the decoding
+// alone, whatever the parent or the cases before held.
+
+#define MINITERATIONS                  3
+
+typedef struct case_s {
+	const char*                        name;
+	const char*                        about;
+	UNSIGNED                           width;              // Screen size.
+	UNSIGNED                           height;
+	unsigned long                      frames;
+	UNSIGNED                           framewidth;         // Size of the frames after the first one.
+	UNSIGNED                           frameheight;
+	GBYTE                              colors;             // Colors in use, at most 255.
+	GBOOL                              interlaced;
+	GBOOL                              lct;                // A local color table per frame.
+	GBOOL                              transparent;
+} case_t;
+
+static const case_t                    Cases[] = {
+	{"emoji",     "72x72, 12 frames, transparent",         72,   72,   12,  72,   72,   64,  GFALSE, GFALSE, GTRUE},
+	{"single",    "1920x1080, 1 frame",                    1920, 1080, 1,   0,    0,    200, GFALSE, GFALSE, GFALSE},
+	{"animation", "480x270, 300 frames, partial updates",  480,  270,  300, 160,  90,   120, GFALSE, GFALSE, GTRUE},
+	{"interlace", "1024x768, 1 frame, interlaced",         1024, 768,  1,   0,    0,    200, GTRUE,  GFALSE, GFALSE},
+	{"lct",       "320x240, 200 frames, local tables",     320,  240,  200, 320,  240,  255, GFALSE, GTRUE,  GFALSE}
+};
+
+#define CASES                          (sizeof (Cases) / sizeof (Cases[0]))
+
+// Stream over a memory buffer, read through the stream functions as a file
+// would be.
+
+typedef struct source_s {
+	const GBYTE*                       data;
+	unsigned long                      size;
+	unsigned long                      position;
+} source_t;
+
+static unsigned long                   Seed;
+static volatile unsigned long          Allocations;
+
+unsigned long BM_Random (void) {
+	Seed = Seed * 1103515245UL + 12345UL;
+
+	return (Seed >> 16) & 0x7FFF;
+}
+
+double BM_Now (void) {
+	struct timespec t;
+
+	clock_gettime (CLOCK_MONOTONIC, &t);
+
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+/*
+  Returns the peak resident size of the process so far, in kilobytes.
+*/
+
+long BM_PeakResident (void) {
+	struct rusage usage;
+
+	if (getrusage (RUSAGE_SELF, &usage) < 0) {
+		return 0;
+	}
+
+	// Linux counts kilobytes, macOS bytes.
+
+#ifdef __APPLE__
+	return usage.ru_maxrss / 1024;
+#else
+	return usage.ru_maxrss;
+#endif
+}
+
+GBOOL BM_Read (void* user, void* ptr, unsigned long count) {
+	source_t* s;
+
+	s = (source_t*) user;
+
+	if (count > s->size - s->position) {
+		return GFALSE;
+	}
+
+	memcpy (ptr, s->data + s->position, count);
+	s->position += count;
+
+	return GTRUE;
+}
+
+GBOOL BM_Move (void* user, long offset) {
+	source_t* s;
+
+	s = (source_t*) user;
+
+	if (offset < 0 ? (unsigned long) -offset > s->position : (unsigned long) offset > s->size - s->position) {
+		return GFALSE;
+	}
+
+	s->position += offset;
+
+	return GTRUE;
+}
+
+GBOOL BM_Write (void* user, const void* ptr, unsigned long count) {
+	buffer_t* b;
+
+	b = (buffer_t*) user;
+
+	if (!B_ReserveBuffer (b, b->size + count)) {
+		return GFALSE;
+	}
+
+	memcpy ((GBYTE*) b->data + b->size, ptr, count);
+	b->size += count;
+
+	return GTRUE;
+}
+
+// Allocator counting the allocations made for the decoded GIF.
+
+void* BM_Alloc (void* user, unsigned long size) {
+	Allocations++;
+
+	return malloc (size);
+}
+
+void* BM_Resize (void* user, void* ptr, unsigned long oldsize, unsigned long size) {
+	Allocations++;
+
+	return realloc (ptr, size);
+}
+
+void BM_Free (void* user, void* ptr) {
+	free (ptr);
+}
+
+rgb_t* BM_NewColorTable (gif_t* gif) {
+	rgb_t*        table;
+	unsigned long k;
+
+	if ((table = (rgb_t*) A_Alloc (&gif->allocator, sizeof (rgb_t) * 256)) == NULL) {
+		return NULL;
+	}
+
+	for (k = 0; k < 256; k++) {
+		table[k].red   = (GBYTE) BM_Random ();
+		table[k].green = (GBYTE) BM_Random ();
+		table[k].blue  = (GBYTE) BM_Random ();
+	}
+
+	return table;
+}
+
+/*
+  Paints a frame the way real content looks to LZW: flat areas and gradients
+  with some noise on top.
+*/
+
+void BM_Paint (GBYTE* p, UNSIGNED width, UNSIGNED height, const case_t* c, unsigned long frame) {
+	unsigned long x, y, v;
+
+	for (y = 0; y < height; y++) {
+		for (x = 0; x < width; x++, p++) {
+			v = ((x + frame * 3) / 16 + (y / 12) * 5) % c->colors;
+
+			if (BM_Random () % 8 == 0) {
+				v = BM_Random () % c->colors;
+			}
+
+			*p = (GBYTE) v;
+		}
+	}
+
+	// Index 255, never painted, is the transparent one.
+
+	if (c->transparent && frame > 0) {
+		for (p -= (unsigned long) width * height, y = 0; y < (unsigned long) width * height; y += 7) {
+			p[y] = 255;
+		}
+	}
+}
+
+/*
+  Builds the GIF of case "c", with its frames painted.
+*/
+
+gif_t* BM_NewGif (const case_t* c) {
+	gif_t*        gif;
+	image_t*      i;
+	image_t*      last;
+	unsigned long k;
+
+	if ((gif = (gif_t*) calloc (1, sizeof (gif_t))) == NULL) {
+		return NULL;
+	}
+
+	A_DefaultAllocator (&gif->allocator);
+
+	gif->screenwidth  = c->width;
+	gif->screenheight = c->height;
+	gif->gctsize      = 256;
+	gif->loop         = c->frames > 1;
+	last              = NULL;
+
+	if ((gif->gct = BM_NewColorTable (gif)) == NULL) {
+		goto clean;
+	}
+
+	for (k = 0; k < c->frames; k++) {
+		if ((i = (image_t*) A_Alloc (&gif->allocator, sizeof (image_t))) == NULL) {
+			goto clean;
+		}
+
+		memset (i, 0, sizeof (image_t));
+
+		if (last) {
+			last->next = i;
+		} else {
+			gif->images = i;
+		}
+
+		last = i;
+		gif->imagecount++;
+
+		i->width       = k > 0 ? c->framewidth : c->width;
+		i->height      = k > 0 ? c->frameheight : c->height;
+		i->left        = (UNSIGNED) (k > 0 ? BM_Random () % (c->width - i->width + 1) : 0);
+		i->top         = (UNSIGNED) (k > 0 ? BM_Random () % (c->height - i->height + 1) : 0);
+		i->delaytime   = c->frames > 1 ? 4 : 0;
+		i->interlaced  = c->interlaced;
+		i->transparent = c->transparent;
+		i->trnspindex  = 255;
+		i->disposal    = c->frames > 1 ? 1 : 0;
+
+		if (c->lct) {
+			if ((i->lct = BM_NewColorTable (gif)) == NULL) {
+				goto clean;
+			}
+
+			i->lctsize = 256;
+		}
+
+		if ((i->indexes = B_AllocBuffer (&gif->allocator, (unsigned long) i->width * i->height)) == NULL) {
+			goto clean;
+		}
+
+		i->indexes->size = (unsigned long) i->width * i->height;
+		BM_Paint ((GBYTE*) i->indexes->data, i->width, i->height, c, k);
+	}
+
+	return gif;
+
+clean:
+	GIF_FreeGif (gif);
+
+	return NULL;
+}
+
+/*
+  Tells whether "data" decodes to the frames of "gif".
+*/
+
+GBOOL BM_Verify (gif_t* gif, const buffer_t* data) {
+	gif_t*   back;
+	image_t* i;
+	image_t* j;
+	GBOOL    ok;
+
+	if (!GIF_ProcessMemory (&back, (const GBYTE*) data->data, data->size)) {
+		return GFALSE;
+	}
+
+	ok = back->imagecount == gif->imagecount;
+
+	for (i = gif->images, j = back->images; ok && i && j; i = i->next, j = j->next) {
+		ok = i->width == j->width && i->height == j->height && !memcmp (i->indexes->data, j->indexes->data, i->indexes->size);
+	}
+
+	GIF_FreeGif (back);
+
+	return ok;
+}
+
+/*
+  Encodes the GIF of case "c", checks it and writes it to "fd". Runs in a
+  child process, so the frames painted take no room in the decoding one.
+*/
+
+int BM_Encode (const case_t* c, int fd) {
+	buffer_t*     data;
+	gif_t*        gif;
+	unsigned long k;
+	ssize_t       n;
+
+	Seed = 1;
+
+	if ((data = B_AllocBuffer (NULL, 1 << 16)) == NULL || (gif = BM_NewGif (c)) == NULL) {
+		return 1;
+	}
+
+	if (!GIF_WriteStream (gif, &BM_Write, data, 1)) {
+		fprintf (stderr, "%s: cannot encode\n", c->name);
+		return 1;
+	}
+
+	if (!BM_Verify (gif, data)) {
+		fprintf (stderr, "%s: frames decoded differ from those painted\n", c->name);
+		return 1;
+	}
+
+	for (k = 0; k < data->size; k += n) {
+		if ((n = write (fd, (const GBYTE*) data->data + k, data->size - k)) <= 0) {
+			return 1;
+		}
+	}
+
+	GIF_FreeGif (gif);
+	B_FreeBuffer (data);
+
+	return 0;
+}
+
+/*
+  Reads the GIF of case "c" into "data" from a child process encoding it.
+*/
+
+GBOOL BM_MakeGif (const case_t* c, buffer_t* data) {
+	pid_t   pid;
+	ssize_t n;
+	int     fd[2], status;
+	GBOOL   ok;
+
+	if (pipe (fd) < 0) {
+		return GFALSE;
+	}
+
+	if ((pid = fork ()) < 0) {
+		close (fd[0]);
+		close (fd[1]);
+		return GFALSE;
+	}
+
+	if (pid == 0) {
+		close (fd[0]);
+		exit (BM_Encode (c, fd[1]));
+	}
+
+	close (fd[1]);
+
+	for (ok = GTRUE; ok; data->size += n) {
+		if (!B_ReserveBuffer (data, data->size + (1 << 16))) {
+			ok = GFALSE;
+			break;
+		}
+
+		if ((n = read (fd[0], (GBYTE*) data->data + data->size, data->allocated - data->size)) <= 0) {
+			ok = n == 0;
+			break;
+		}
+	}
+
+	close (fd[0]);
+
+	if (waitpid (pid, &status, 0) < 0 || !WIFEXITED (status) || WEXITSTATUS (status) != 0) {
+		return GFALSE;
+	}
+
+	return ok;
+}
+
+/*
+  Reads the GIF of case "c", decodes it for at least "seconds" and prints the
+  results. Runs in a child process.
+*/
+
+int BM_Run (const case_t* c, double seconds) {
+	source_t      s;
+	buffer_t*     data;
+	gif_t*        gif;
+	context_t*    ctx;
+	allocator_t   a;
+	unsigned long iterations, frames, allocations;
+	double        start, elapsed;
+	long          resident;
+
+	if ((data = B_AllocBuffer (NULL, 1 << 16)) == NULL || !BM_MakeGif (c, data)) {
+		return 1;
+	}
+
+	resident = BM_PeakResident ();
+
+	s.data = (const GBYTE*) data->data;
+	s.size = data->size;
+
+	// Count the allocations of one decode, then time the plain entry point.
+
+	a.alloc  = &BM_Alloc;
+	a.resize = &BM_Resize;
+	a.free   = &BM_Free;
+	a.user   = NULL;
+
+	s.position = 0;
+
+	if ((ctx = GIF_NewContext (&BM_Read, &BM_Move, &s)) == NULL) {
+		return 1;
+	}
+
+	GIF_SetAllocator (ctx, &a);
+
+	if (!GIF_Decode (ctx, &gif)) {
+		fprintf (stderr, "%s: cannot decode\n", c->name);
+		return 1;
+	}
+
+	allocations = Allocations;
+	frames      = gif->imagecount;
+
+	GIF_FreeGif (gif);
+	GIF_FreeContext (ctx);
+
+	iterations = 0;
+	start      = BM_Now ();
+
+	do {
+		s.position = 0;
+
+		if (!GIF_ProcessStream (&gif, &BM_Read, &BM_Move, &s)) {
+			return 1;
+		}
+
+		GIF_FreeGif (gif);
+		iterations++;
+		elapsed = BM_Now () - start;
+	} while (elapsed < seconds || iterations < MINITERATIONS);
+
+	printf ("%-10s %-38s %10lu %7lu %9.1f %11.1f %7lu %9ld\n", c->name, c->about, s.size, iterations,
+		s.size * (double) iterations / elapsed / 1e6, frames * (double) iterations / elapsed, allocations, BM_PeakResident () - resident);
+	fflush (stdout);
+
+	B_FreeBuffer (data);
+
+	return 0;
+}
+
+int main (int argc, char** argv) {
+	double        seconds;
+	unsigned long k;
+	GBOOL         selected;
+	pid_t         pid;
+	int           status, a, first, failed;
+
+	seconds = 1.0;
+	first   = 1;
+	failed  = 0;
+
+	if (argc > 2 && !strcmp (argv[1], "-t")) {
+		seconds = atof (argv[2]);
+		first   = 3;
+	}
+
+	printf ("%-10s %-38s %10s %7s %9s %11s %7s %9s\n", "case", "", "bytes", "runs", "MB/s", "frames/s", "allocs", "added KB");
+
+	for (k = 0; k < CASES; k++) {
+
+		// Cases named on the command line, or all of them.
+
+		for (a = first, selected = argc <= first; a < argc; a++) {
+			if (!strcmp (argv[a], Cases[k].name)) {
+				selected = GTRUE;
+			}
+		}
+
+		if (!selected) {
+			continue;
+		}
+
+		fflush (stdout);
+
+		if ((pid = fork ()) < 0) {
+			return 1;
+		}
+
+		if (pid == 0) {
+			exit (BM_Run (Cases + k, seconds));
+		}
+
+		if (waitpid (pid, &status, 0) < 0 || !WIFEXITED (status) || WEXITSTATUS (status) != 0) {
+			printf ("%-10s failed\n", Cases[k].name);
+			failed = 1;
+		}
+	}
+
+	return failed;
+}
@@ -0,0 +1,35 @@
+#ifndef ALLOC_H
+#define ALLOC_H
+
+#include "defs.h"
+
+// Allocation functions. The first argument is the user data given along with
+// them. The resize function also gets the current size of the block. A NULL
+// free function means blocks are released all at once by their owner.
+
+typedef void*                          (*MA)(void*, unsigned long);
+typedef void*                          (*MR)(void*, void*, unsigned long, unsigned long);
+typedef void                           (*MF)(void*, void*);
+
+typedef struct allocator_s {
+	MA                                 alloc;
+	MR                                 resize;
+	MF                                 free;
+	void*                              user;
+} allocator_t;
+
+// Arena: blocks are carved from large chunks and released together.
+
+typedef struct arena_s arena_t;
+
+	void*                              A_Alloc (const allocator_t* a, unsigned long size);
+	void*                              A_Resize (const allocator_t* a, void* ptr, unsigned long oldsize, unsigned long size);
+	void                               A_Free (const allocator_t* a, void* ptr);
+	void                               A_DefaultAllocator (allocator_t* a);
+	unsigned long                      A_Allocations (void);
+	arena_t*                           A_NewArena (unsigned long chunksize);
+	void                               A_ResetArena (arena_t* arena);
+	void                               A_FreeArena (arena_t* arena);
+	void                               A_ArenaAllocator (arena_t* arena, allocator_t* a);
+
+#endif
@@ -1,18 +1,21 @@
 #ifndef BUFFER_H
 #define BUFFER_H
 
-#include "defs.h"
+#include "alloc.h"
 
 typedef struct buffer_s {
 	void*                              data;
 	unsigned long                      allocated;
 	unsigned long                      size;
 	unsigned long                      index;
+	allocator_t                        allocator;          // Allocator owning the buffer.
 } buffer_t;
 
-	buffer_t*                          B_NewBuffer (unsigned long size);
+	buffer_t*                          B_NewBuffer (const allocator_t* a, unsigned long size);
+	buffer_t*                          B_AllocBuffer (const allocator_t* a, unsigned long size);
+	GBOOL                              B_ReserveBuffer (buffer_t* buffer, unsigned long size);
 	void                               B_FreeBuffer (buffer_t* buffer);
-	GBOOL                              B_WriteBuffer (buffer_t* buffer, MS read, unsigned long count);
+	GBOOL                              B_WriteBuffer (buffer_t* buffer, MS read, void* user, unsigned long count);
 	void                               B_CopyBuffer (buffer_t* dest, buffer_t* src);
 	GBOOL                              B_CopyStreamToBuffer (buffer_t* buffer, GBYTE* stream, unsigned long count);
 	void                               B_CopyBufferToStream (buffer_t* buffer, GBYTE* stream);
@@ -0,0 +1,35 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "index.h"
+
+// Frame held from a cache. "data" stays valid until the frame is released,
+// even if the cache evicts it meanwhile. The other fields belong to the cache.
+
+typedef struct cachedframe_s {
+	GBYTE*                             data;               // Frame data: indexes, pixels or anything else.
+	unsigned long                      size;               // Bytes in "data".
+	unsigned long long                 hash;               // Hash of the GIF the frame is of.
+	unsigned long                      frame;              // Frame number.
+	unsigned long                      refs;               // Holders of the frame.
+	GBOOL                              cached;             // Still in the cache.
+	struct cachedframe_s*              newer;              // Use order, most recent first.
+	struct cachedframe_s*              older;
+	struct cachedframe_s*              next;               // Next frame in the same bucket.
+} cachedframe_t;
+
+// Cache of decoded frames keyed by GIF content hash and frame number. Frames
+// are evicted least recently used first once their bytes exceed the budget.
+// Every function can be called from any thread.
+
+typedef struct framecache_s framecache_t;
+
+	framecache_t*                      FC_NewCache (unsigned long budget);
+	void                               FC_FreeCache (framecache_t* cache);
+	unsigned long long                 FC_Hash (const GBYTE* data, unsigned long size);
+	cachedframe_t*                     FC_Lookup (framecache_t* cache, unsigned long long hash, unsigned long frame);
+	cachedframe_t*                     FC_Insert (framecache_t* cache, unsigned long long hash, unsigned long frame, const GBYTE* data, unsigned long size);
+	void                               FC_Release (framecache_t* cache, cachedframe_t* frame);
+	cachedframe_t*                     FC_RenderFrame (framecache_t* cache, context_t* ctx, frameindex_t* index, unsigned long long hash, unsigned long frame, canvas_t** canvas);
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef CANVAS_H
+#define CANVAS_H
+
+#include "gif.h"
+
+// Disposal methods of a graphic control extension.
+
+#define DISPOSALNONE                   0
+#define DISPOSALKEEP                   1
+#define DISPOSALBACKGROUND             2
+#define DISPOSALPREVIOUS               3
+
+// Screen-sized RGBA canvas the images of a GIF are composited onto, in order.
+// Pixels are four bytes: red, green, blue and alpha. Areas restored to the
+// background become transparent, as browsers do. After each image, the
+// dirty rectangle covers every pixel that changed since the previous one.
+
+typedef struct canvas_s {
+	GBYTE*                             pixels;             // RGBA pixels, row after row.
+	UNSIGNED                           width;              // Screen width.
+	UNSIGNED                           height;             // Screen height.
+	UNSIGNED                           dirtyleft;          // Dirty rectangle of the last image.
+	UNSIGNED                           dirtytop;
+	UNSIGNED                           dirtywidth;
+	UNSIGNED                           dirtyheight;
+	GBYTE                              disposal;           // Disposal of the last image, done before the next one.
+	UNSIGNED                           left;               // Area of the last image, clipped to the screen.
+	UNSIGNED                           top;
+	UNSIGNED                           areawidth;
+	UNSIGNED                           areaheight;
+	GBYTE*                             saved;              // Pixels under the last image, for DISPOSALPREVIOUS.
+	unsigned long                      savedsize;          // Bytes allocated for "saved".
+} canvas_t;
+
+	canvas_t*                          CV_NewCanvas (gif_t* gif);
+	void                               CV_FreeCanvas (canvas_t* canvas);
+	void                               CV_ResetCanvas (canvas_t* canvas);
+	GBOOL                              CV_DrawImage (canvas_t* canvas, gif_t* gif, image_t* image);
+
+#endif
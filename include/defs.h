@@ -8,8 +8,12 @@ typedef unsigned char                  GBYTE;
 typedef unsigned short                 UNSIGNED;
 typedef unsigned char                  GBOOL;
 
-typedef GBOOL                          (*MS)(void*, unsigned long);
-typedef GBOOL                          (*MSP)(long);
+// Read, move pointer and write functions over a GIF data stream. The first
+// argument is the user data given along with them.
+
+typedef GBOOL                          (*MS)(void*, void*, unsigned long);
+typedef GBOOL                          (*MSP)(void*, long);
+typedef GBOOL                          (*MW)(void*, const void*, unsigned long);
 
 #endif
 
@@ -0,0 +1,25 @@
+#ifndef FORMAT_H
+#define FORMAT_H
+
+// Layout of a GIF data stream, shared by the decoder and the encoder.
+
+#define CODETABLESIZE                  4096
+#define MAXBLOCKSIZE                   256
+#define MAXCODEBITS                    12
+#define MAXINDEXBITS                   8
+#define EXTENSIONBLOCK                 0x21
+#define IMAGESEPARATOR                 0x2C
+#define PLAINTEXTLABEL                 0x01
+#define GRAPHICCONTROLLABEL            0xF9
+#define COMMENTLABEL                   0xFE
+#define APPLICATIONEXTENSIONLABEL      0xFF
+#define TRAILER                        0x3B
+#define HEADERSIZE                     6
+#define LSDSIZE                        7
+#define IMAGEDESCRIPTORSIZE            9
+#define GCESIZE                        6
+#define APPEXTSIZE                     12
+#define TEXTSIZE                       13
+#define MAXCOLORTABLESIZE              (256 * 3)
+
+#endif
@@ -6,27 +6,94 @@
 #define APPLICATIONIDSIZE              8
 #define APPLICATIONAUTHCODESIZE        3
 
+// Why the last decode of a context failed, as told by GIF_GetError(). Each
+// limit exceeded has an error of its own. Streams cut short or damaged by
+// the errors from ERRORTRUNCATED to ERRORBADBLOCK can still be decoded in
+// tolerant mode, see GIF_SetTolerant().
+
+#define ERRORNONE                      0
+#define ERRORFAILED                    1                   // Any other failure.
+#define ERRORLIMITPIXELS               2
+#define ERRORLIMITFRAMES               3
+#define ERRORLIMITBYTES                4
+#define ERRORLIMITEXTENSION            5
+#define ERRORLIMITTIME                 6
+#define ERRORMEMORY                    7                   // Out of memory.
+#define ERRORSTOPPED                   8                   // A user function returned GFALSE.
+#define ERRORNOTGIF                    9                   // No GIF signature and version.
+#define ERRORTRUNCATED                 10                  // The data ends before the trailer.
+#define ERRORBADCODE                   11                  // Image data that is not valid LZW.
+#define ERRORBADTERMINATOR             12                  // Block not followed by its block terminator.
+#define ERRORBADBLOCK                  13                  // Unknown block, or block of a wrong size.
+#define ERRORUNSUPPORTED               14                  // GIF version other than 87a and 89a.
+
 typedef struct rgb_s {
 	GBYTE                              red;
 	GBYTE                              green;
 	GBYTE                              blue;
 } rgb_t;
 
+// Color table shared by all the tables of a GIF holding the same colors.
+// "rgba" is the table as opaque RGBA pixels, ready for palette expansion: an
+// image only has to clear the alpha of its transparent index.
+
+typedef struct palette_s {
+	rgb_t*                             colors;
+	UNSIGNED                           size;               // Entries in "colors".
+	unsigned long                      hash;               // Hash of "colors".
+	unsigned long                      refs;               // Tables using the palette.
+	unsigned int                       rgba[256];          // Colors as RGBA pixels, opaque black past "size".
+	struct palette_s*                  next;               // Next palette of the GIF.
+} palette_t;
+
+// Comment extension. It comes after "image" images of the stream.
+
 typedef struct comment_s {
 	char*                              comment;
+	unsigned long                      image;              // Images before the comment.
 	struct comment_s*                  next;
 } comment_t;
 
+// Plain text extension: text drawn in a grid of character cells over the
+// images, in colors of the table in use. It comes after "image" images of the
+// stream and takes its graphic control extension as an image would.
+
+typedef struct text_s {
+	char*                              text;
+	UNSIGNED                           left;               // Text grid position and size, in pixels.
+	UNSIGNED                           top;
+	UNSIGNED                           width;
+	UNSIGNED                           height;
+	GBYTE                              cellwidth;          // Character cell size, in pixels.
+	GBYTE                              cellheight;
+	GBYTE                              foreground;         // Color index of the text.
+	GBYTE                              background;         // Color index of the cells.
+	UNSIGNED                           delaytime;
+	GBOOL                              transparent;
+	GBYTE                              trnspindex;
+	GBYTE                              disposal;           // Disposal method once displayed.
+	GBOOL                              userinput;          // Waits for user input.
+	unsigned long                      image;              // Images before the text.
+	struct text_s*                     next;
+} text_t;
+
+// Application extension: data of an application, named by "appid". It comes
+// after "image" images of the stream.
+
 typedef struct app_s {
 	GBYTE                              appid[APPLICATIONIDSIZE];
 	GBYTE                              authcode[APPLICATIONAUTHCODESIZE];
-	GBYTE*                             data;
+	GBYTE*                             data;               // Data sub-blocks contents.
+	unsigned long                      size;
+	unsigned long                      image;              // Images before the application.
 	struct app_s*                      next;
 } app_t;
 
 typedef struct image_s {
 	rgb_t*                             lct;
-	buffer_t*                          indexes;
+	UNSIGNED                           lctsize;            // Entries in "lct".
+	palette_t*                         palette;            // Palette "lct" belongs to. NULL if not shared.
+	buffer_t*                          indexes;            // Rows top to bottom. NULL when the stream was only scanned.
 	UNSIGNED                           left;
 	UNSIGNED                           top;
 	UNSIGNED                           width;
@@ -34,25 +101,121 @@ typedef struct image_s {
 	UNSIGNED                           delaytime;
 	GBOOL                              transparent;
 	GBYTE                              trnspindex;
+	GBYTE                              disposal;           // Disposal method once displayed.
+	GBOOL                              userinput;          // Waits for user input.
 	GBOOL                              interlaced;
 	GBOOL                              sorted;
+	unsigned long                      gceoffset;          // Offset of the graphic control extension, 0 if none.
+	unsigned long                      descoffset;         // Offset of the image descriptor.
+	unsigned long                      dataoffset;         // Offset of the image data in the stream.
+	unsigned long long                 decodetime;         // Nanoseconds spent decoding the image, with GIF_STATS.
+	GBOOL                              damaged;            // Decoding stopped at an error; the indexes past it are filled.
 	struct image_s*                    next;
 } image_t;
 
 typedef struct gif_s {
 	rgb_t*                             gct;
+	UNSIGNED                           gctsize;            // Entries in "gct".
+	palette_t*                         palette;            // Palette "gct" belongs to. NULL if not shared.
+	palette_t*                         palettes;           // Color tables of the GIF, each held once.
 	UNSIGNED                           screenwidth;
 	UNSIGNED                           screenheight;
 	GBOOL                              background;
 	GBYTE                              bkgindex;
 	GBYTE                              aspectratio;
+	GBOOL                              loop;               // A looping application extension was found.
+	UNSIGNED                           loopcount;          // Times to loop, 0 for ever.
+	unsigned long                      imagecount;
 	image_t*                           images;
 	comment_t*                         comments;
-	app_t* apps;
+	text_t*                            texts;
+	app_t*                             apps;
+	allocator_t                        allocator;          // Allocator of the GIF and all it holds.
 } gif_t;
 
-GBOOL                                  GIF_ProcessStream (gif_t** gif, MS r, MSP mp);
+// Limits a decode must keep within, to turn down hostile streams before they
+// take memory or time. Sizes are checked as soon as they are read, before
+// anything is allocated for them; time is checked as images decode. A limit
+// of 0 is no limit.
+
+typedef struct limits_s {
+	unsigned long                      pixels;             // Pixels of the screen and of each image.
+	unsigned long                      frames;             // Images in the stream.
+	unsigned long long                 bytes;              // Indexes decoded, for all the images together.
+	unsigned long                      extension;          // Bytes of comment, plain text and application data kept.
+	unsigned long                      milliseconds;       // Time the decode may take; all the pushes together.
+} limits_t;
+
+// Statistics of the last decode of a context, kept when the library is built
+// with GIF_STATS. Times are in nanoseconds and include the functions called
+// back meanwhile; "decodetime" adds up that of every thread decoding images.
+
+typedef struct stats_s {
+	unsigned long long                 bytesread;          // Bytes read through the read function, or pushed.
+	unsigned long                      reads;              // Calls to the read function, or pushes.
+	unsigned long                      moves;              // Calls to the move function.
+	unsigned long long                 codes;              // LZW codes decoded.
+	unsigned long                      clears;             // Clear codes.
+	unsigned long                      flushes;            // Clear codes dropping codes from the table.
+	unsigned long                      maxstring;          // Longest string decoded from one code.
+	unsigned long                      allocations;        // Blocks allocated or resized.
+	unsigned long long                 readtime;           // Spent in the read and move functions.
+	unsigned long long                 decodetime;         // Spent decoding image data.
+	unsigned long long                 totaltime;          // Spent in the whole decode.
+} stats_t;
+
+// Decoder context. Holds the stream functions and their user data, or the
+// memory span to decode from, and the decoder scratch tables. A context is
+// used by one thread at a time, but any number of contexts can decode
+// concurrently.
+
+typedef struct context_s context_t;
+
+// Image function of the push parser. Called with the user data, the GIF being
+// built and the image being decoded, of which "indexes->size" indexes are
+// decoded; the last argument tells whether the image is complete. Rows land
+// in place: in order for plain images, in the order given by
+// GIF_InterlacedRow() for interlaced ones. Returning GFALSE stops the
+// decoding.
+
+typedef GBOOL                          (*IS)(void*, gif_t*, image_t*, GBOOL);
+
+// Frame and row functions of the streaming decoder. Called with the user data,
+// the GIF being decoded and the image being decoded; the row function also
+// gets the row number, counted from the top, and its indexes. Returning
+// GFALSE stops the decoding.
+
+typedef GBOOL                          (*FS)(void*, gif_t*, image_t*);
+typedef GBOOL                          (*RS)(void*, gif_t*, image_t*, UNSIGNED, const GBYTE*);
+
+context_t*                             GIF_NewContext (MS r, MSP mp, void* user);
+context_t*                             GIF_NewMemoryContext (const GBYTE* data, unsigned long size);
+context_t*                             GIF_NewFileContext (const char* path);
+context_t*                             GIF_NewPushContext (IS f, void* user);
+void                                   GIF_FreeContext (context_t* ctx);
+void                                   GIF_SetThreads (context_t* ctx, unsigned int threads);
+void                                   GIF_SetAllocator (context_t* ctx, const allocator_t* a);
+GBOOL                                  GIF_SetScale (context_t* ctx, UNSIGNED width, UNSIGNED height);
+GBOOL                                  GIF_GetStats (context_t* ctx, stats_t* stats);
+void                                   GIF_SetLimits (context_t* ctx, const limits_t* limits);
+void                                   GIF_SetTolerant (context_t* ctx, GBOOL tolerant);
+unsigned int                           GIF_GetError (context_t* ctx);
+GBOOL                                  GIF_Decode (context_t* ctx, gif_t** gif);
+GBOOL                                  GIF_Scan (context_t* ctx, gif_t** gif);
+GBOOL                                  GIF_DecodeRange (context_t* ctx, gif_t** gif, unsigned long offset, unsigned long count);
+GBOOL                                  GIF_Stream (context_t* ctx, gif_t** gif, FS frame, RS row, void* user);
+GBOOL                                  GIF_Push (context_t* ctx, const GBYTE* data, unsigned long size);
+GBOOL                                  GIF_EndPush (context_t* ctx, gif_t** gif);
+GBOOL                                  GIF_ProcessStream (gif_t** gif, MS r, MSP mp, void* user);
+GBOOL                                  GIF_ProcessMemory (gif_t** gif, const GBYTE* data, unsigned long size);
+GBOOL                                  GIF_ProcessFile (gif_t** gif, const char* path);
+GBOOL                                  GIF_ScanStream (gif_t** gif, MS r, MSP mp, void* user);
+GBOOL                                  GIF_ScanMemory (gif_t** gif, const GBYTE* data, unsigned long size);
+GBOOL                                  GIF_ScanFile (gif_t** gif, const char* path);
 void                                   GIF_FreeGif (gif_t* gif);
+unsigned long                          GIF_InterlacedRow (unsigned long row, UNSIGNED height);
+GBOOL                                  GIF_WriteStream (gif_t* gif, MW w, void* user, unsigned int threads);
+GBOOL                                  GIF_WriteFile (gif_t* gif, const char* path, unsigned int threads);
 
 #endif
 
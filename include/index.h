@@ -0,0 +1,37 @@
+#ifndef INDEX_H
+#define INDEX_H
+
+#include "canvas.h"
+
+// Where a frame lies in the stream. Offsets count from the start of the
+// stream; "gceoffset" and "lctoffset" are 0 when the frame has none.
+
+typedef struct frameentry_s {
+	unsigned long                      offset;             // First block of the frame: its GCE, or its descriptor.
+	unsigned long                      gceoffset;          // Graphic control extension.
+	unsigned long                      descoffset;         // Image descriptor.
+	unsigned long                      lctoffset;          // Local color table.
+	unsigned long                      dataoffset;         // LZW minimum code size, then the image data.
+	GBOOL                              keyframe;           // Drawn the same on a cleared canvas.
+} frameentry_t;
+
+// Frame index of a GIF. A keyframe does not depend on the frames before it:
+// the canvas it is drawn onto is either cleared or fully covered by it. Any
+// frame can then be rendered by drawing from the nearest keyframe before it.
+// The index can be saved to a compact blob and loaded back, so a stream only
+// has to be scanned once.
+
+typedef struct frameindex_s {
+	unsigned long                      count;              // Number of frames.
+	frameentry_t*                      frames;
+} frameindex_t;
+
+	frameindex_t*                      FI_NewIndex (gif_t* gif);
+	frameindex_t*                      FI_BuildIndex (context_t* ctx);
+	void                               FI_FreeIndex (frameindex_t* index);
+	buffer_t*                          FI_SaveIndex (frameindex_t* index);
+	frameindex_t*                      FI_LoadIndex (const GBYTE* data, unsigned long size);
+	unsigned long                      FI_KeyFrame (frameindex_t* index, unsigned long frame);
+	GBOOL                              FI_DecodeFrame (context_t* ctx, frameindex_t* index, unsigned long frame, canvas_t** canvas);
+
+#endif
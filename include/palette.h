@@ -0,0 +1,22 @@
+#ifndef PALETTE_H
+#define PALETTE_H
+
+#include "gif.h"
+
+// Pixel formats indexes are expanded to. Four-byte formats keep alpha last.
+
+#define PIXELRGBA                      0
+#define PIXELBGRA                      1
+#define PIXELRGB                       2
+#define PIXELBGR                       3
+
+// Palette expansion. A color table is first turned into a 256-entry lookup
+// table of four-byte pixels in the output format, then rows of indexes are
+// expanded through it. Kernels use AVX2 or SSSE3 when the processor has them
+// and fall back to plain C otherwise.
+
+	void                               P_MakeTable (unsigned int* table, const rgb_t* colors, unsigned long items, GBYTE format, GBOOL transparent, GBYTE trnspindex);
+	void                               P_ExpandRow (const unsigned int* table, const GBYTE* indexes, GBYTE* out, unsigned long count, GBYTE format);
+	void                               P_DrawRow (const unsigned int* table, const GBYTE* indexes, GBYTE* out, unsigned long count, GBYTE format);
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef THREAD_H
+#define THREAD_H
+
+#include "defs.h"
+
+// Thin layer over the system threads and clock (Win32 or POSIX).
+
+typedef void                           (*TF)(void*);
+
+typedef struct thread_s thread_t;
+typedef struct mutex_s mutex_t;
+
+	thread_t*                          T_NewThread (TF f, void* arg);
+	void                               T_JoinThread (thread_t* thread);
+	long                               T_Increment (volatile long* value);
+	long                               T_Load (volatile long* value);
+	void                               T_Store (volatile long* value, long v);
+	mutex_t*                           T_NewMutex (void);
+	void                               T_FreeMutex (mutex_t* mutex);
+	void                               T_Lock (mutex_t* mutex);
+	void                               T_Unlock (mutex_t* mutex);
+	unsigned long long                 T_Time (void);
+
+#endif
@@ -0,0 +1,231 @@
+#include <stdlib.h>
+#include <string.h>
+#include "alloc.h"
+
+// Blocks handed out by an arena are aligned to this many bytes.
+
+#define ARENAALIGNMENT                 16
+
+#define ARENAROUND(n)                  (((n) + ARENAALIGNMENT - 1) & ~((unsigned long) ARENAALIGNMENT - 1))
+
+// Built with GIF_STATS, allocations are counted per thread, so a decode can
+// tell its own from those of other threads.
+
+#ifdef GIF_STATS
+#ifdef _MSC_VER
+#define THREADLOCAL                    __declspec(thread)
+#else
+#define THREADLOCAL                    __thread
+#endif
+
+static THREADLOCAL unsigned long       Allocations;
+#endif
+
+typedef struct chunk_s {
+	struct chunk_s*                    next;
+	unsigned long                      size;               // Bytes available after the header.
+	unsigned long                      used;               // Bytes handed out.
+	unsigned long                      pad;                // Keeps the data aligned.
+} chunk_t;
+
+struct arena_s {
+	chunk_t*                           chunks;             // First chunk.
+	chunk_t*                           current;            // Chunk blocks are taken from.
+	unsigned long                      chunksize;          // Size of new chunks.
+	void*                              last;               // Last block handed out.
+};
+
+void* A_Malloc (void* user, unsigned long size) {
+	return malloc (size);
+}
+
+void* A_Realloc (void* user, void* ptr, unsigned long oldsize, unsigned long size) {
+	return realloc (ptr, size);
+}
+
+void A_Release (void* user, void* ptr) {
+	free (ptr);
+}
+
+/*
+  Allocation through "a". A NULL allocator stands for malloc/free.
+*/
+
+void* A_Alloc (const allocator_t* a, unsigned long size) {
+#ifdef GIF_STATS
+	Allocations++;
+#endif
+
+	if (a == NULL) {
+		return malloc (size);
+	}
+
+	return a->alloc (a->user, size);
+}
+
+void* A_Resize (const allocator_t* a, void* ptr, unsigned long oldsize, unsigned long size) {
+#ifdef GIF_STATS
+	Allocations++;
+#endif
+
+	if (a == NULL) {
+		return realloc (ptr, size);
+	}
+
+	return a->resize (a->user, ptr, oldsize, size);
+}
+
+void A_Free (const allocator_t* a, void* ptr) {
+	if (a == NULL) {
+		free (ptr);
+	} else if (a->free) {
+		a->free (a->user, ptr);
+	}
+}
+
+void A_DefaultAllocator (allocator_t* a) {
+	a->alloc  = &A_Malloc;
+	a->resize = &A_Realloc;
+	a->free   = &A_Release;
+	a->user   = NULL;
+}
+
+/*
+  Blocks allocated or resized through A_Alloc() and A_Resize() by the calling
+  thread so far. Always 0 unless built with GIF_STATS.
+*/
+
+unsigned long A_Allocations (void) {
+#ifdef GIF_STATS
+	return Allocations;
+#else
+	return 0;
+#endif
+}
+
+arena_t* A_NewArena (unsigned long chunksize) {
+	arena_t* arena;
+
+	if ((arena = (arena_t*) malloc (sizeof (arena_t))) == NULL) {
+		return NULL;
+	}
+
+	arena->chunks    = NULL;
+	arena->current   = NULL;
+	arena->chunksize = ARENAROUND (chunksize > 0 ? chunksize : 1);
+	arena->last      = NULL;
+
+	return arena;
+}
+
+/*
+  Releases every block of the arena at once. Chunks are kept for reuse.
+*/
+
+void A_ResetArena (arena_t* arena) {
+	chunk_t* c;
+
+	for (c = arena->chunks; c; c = c->next) {
+		c->used = 0;
+	}
+
+	arena->current = arena->chunks;
+	arena->last    = NULL;
+}
+
+void A_FreeArena (arena_t* arena) {
+	chunk_t* c;
+
+	if (arena) {
+		while (arena->chunks) {
+			c = arena->chunks->next;
+			free (arena->chunks);
+			arena->chunks = c;
+		}
+
+		free (arena);
+	}
+}
+
+void* A_ArenaAlloc (void* user, unsigned long size) {
+	arena_t* arena;
+	chunk_t* c;
+	chunk_t* p;
+
+	arena = (arena_t*) user;
+	size  = ARENAROUND (size);
+
+	// Take the block from the first chunk, starting at the current one, with
+	// room enough. Chunks skipped this way are not looked at again until the
+	// arena is reset.
+
+	for (p = NULL, c = arena->current; c; p = c, c = c->next) {
+		if (c->size - c->used >= size) {
+			break;
+		}
+	}
+
+	if (c == NULL) {
+		if ((c = (chunk_t*) malloc (sizeof (chunk_t) + (size > arena->chunksize ? size : arena->chunksize))) == NULL) {
+			return NULL;
+		}
+
+		c->next = NULL;
+		c->size = size > arena->chunksize ? size : arena->chunksize;
+		c->used = 0;
+
+		if (p) {
+			p->next = c;
+		} else {
+			arena->chunks = c;
+		}
+	}
+
+	arena->current = c;
+	arena->last    = (GBYTE*) (c + 1) + c->used;
+	c->used       += size;
+
+	return arena->last;
+}
+
+void* A_ArenaResize (void* user, void* ptr, unsigned long oldsize, unsigned long size) {
+	arena_t* arena;
+	chunk_t* c;
+	void*    p;
+
+	arena = (arena_t*) user;
+
+	if (ptr == NULL) {
+		return A_ArenaAlloc (user, size);
+	}
+
+	// The last block handed out grows in place while its chunk has room.
+
+	c = arena->current;
+
+	if (ptr == arena->last && (GBYTE*) ptr - (GBYTE*) (c + 1) + ARENAROUND (size) <= c->size) {
+		c->used = (GBYTE*) ptr - (GBYTE*) (c + 1) + ARENAROUND (size);
+
+		return ptr;
+	}
+
+	if ((p = A_ArenaAlloc (user, size)) == NULL) {
+		return NULL;
+	}
+
+	memcpy (p, ptr, oldsize < size ? oldsize : size);
+
+	return p;
+}
+
+/*
+  Fills "a" with functions allocating from "arena". Blocks are never freed
+  one by one: A_ResetArena() or A_FreeArena() release them all.
+*/
+
+void A_ArenaAllocator (arena_t* arena, allocator_t* a) {
+	a->alloc  = &A_ArenaAlloc;
+	a->resize = &A_ArenaResize;
+	a->free   = NULL;
+	a->user   = arena;
+}
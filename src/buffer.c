@@ -1,19 +1,42 @@
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 #include "buffer.h"
 
-buffer_t* B_NewBuffer (unsigned long size) {
+buffer_t* B_NewBuffer (const allocator_t* a, unsigned long size) {
 	buffer_t* b;
 
-	if ((b = (buffer_t*) malloc (sizeof (buffer_t))) == NULL) {
-		return GFALSE;
+	if ((b = B_AllocBuffer (a, size)) == NULL) {
+		return NULL;
 	}
 
-	if ((b->data = malloc (size)) == NULL) {
-		goto clean;
+	memset (b->data, 0, size);
+
+	return b;
+}
+
+/*
+  Same as B_NewBuffer, but the contents are left uninitialized. Meant for
+  buffers that will be written before being read. The buffer and its data
+  come from "a", or from malloc if NULL.
+*/
+
+buffer_t* B_AllocBuffer (const allocator_t* a, unsigned long size) {
+	buffer_t* b;
+
+	if ((b = (buffer_t*) A_Alloc (a, sizeof (buffer_t))) == NULL) {
+		return NULL;
 	}
 
-	memset (b->data, 0, size);
+	if (a) {
+		b->allocator = *a;
+	} else {
+		A_DefaultAllocator (&b->allocator);
+	}
+
+	if ((b->data = A_Alloc (a, size)) == NULL) {
+		goto clean;
+	}
 
 	b->allocated = size;
 	b->size = 0;
@@ -22,27 +45,66 @@ buffer_t* B_NewBuffer (unsigned long size) {
 	return b;
 
 clean:
-	free (b);
+	A_Free (a, b);
 
 	return NULL;
 }
 
+/*
+  Makes room for at least "size" bytes, doubling the capacity so growing a
+  buffer little by little costs amortized constant time. Contents are kept.
+*/
+
+GBOOL B_ReserveBuffer (buffer_t* buffer, unsigned long size) {
+	unsigned long allocated;
+	void*         data;
+
+	if (buffer->allocated >= size) {
+		return GTRUE;
+	}
+
+	allocated = buffer->allocated > 0 ? buffer->allocated : 1;
+
+	while (allocated < size && allocated <= ULONG_MAX / 2) {
+		allocated *= 2;
+	}
+
+	// Doubling again would wrap around, e.g. with 32-bit longs.
+
+	if (allocated < size) {
+		allocated = size;
+	}
+
+	if ((data = A_Resize (&buffer->allocator, buffer->data, buffer->allocated, allocated)) == NULL) {
+		return GFALSE;
+	}
+
+	buffer->data = data;
+	buffer->allocated = allocated;
+
+	return GTRUE;
+}
+
 void B_FreeBuffer (buffer_t* buffer) {
+	allocator_t a;
+
 	if (buffer) {
+		a = buffer->allocator;
+
 		if (buffer->data) {
-			free (buffer->data);
+			A_Free (&a, buffer->data);
 		}
 
-		free (buffer);
+		A_Free (&a, buffer);
 	}
 }
 
-GBOOL B_WriteBuffer (buffer_t* buffer, MS read, unsigned long count) {
+GBOOL B_WriteBuffer (buffer_t* buffer, MS read, void* user, unsigned long count) {
 	if (buffer->size + count > buffer->allocated) {
 		return GFALSE;
 	}
 
-	if (!read (buffer->data, count)) {
+	if (!read (user, buffer->data, count)) {
 		return GFALSE;
 	}
 
@@ -52,7 +114,7 @@ GBOOL B_WriteBuffer (buffer_t* buffer, MS read, unsigned long count) {
 }
 
 void B_CopyBuffer (buffer_t* dest, buffer_t* src) {
-	unsigned long i, count;
+	unsigned long count;
 
 	// Avoid buffer overrun.
 	if (src->size > dest->allocated) {
@@ -61,23 +123,18 @@ void B_CopyBuffer (buffer_t* dest, buffer_t* src) {
 		count = src->size;
 	}
 
-	for (i = 0; i < count; i++) {
-		((GBYTE*) dest->data)[i] = ((GBYTE*) src->data)[i];
-	}
+	memcpy (dest->data, src->data, count);
 
 	dest->size = count;
 }
 
 GBOOL B_CopyStreamToBuffer (buffer_t* buffer, GBYTE* stream, unsigned long count) {
-	unsigned long i;
-
-	if (buffer->size + count > buffer->allocated) {
+	if (buffer->index + count > buffer->allocated) {
 		return GFALSE;
 	}
 
-	for (i = 0; i < count; i++, buffer->index++) {
-		((GBYTE*) buffer->data)[buffer->index] = stream[i];
-	}
+	memcpy ((GBYTE*) buffer->data + buffer->index, stream, count);
+	buffer->index += count;
 
 	if (buffer->size < buffer->index) {
 		buffer->size = buffer->index;
@@ -87,23 +144,16 @@ GBOOL B_CopyStreamToBuffer (buffer_t* buffer, GBYTE* stream, unsigned long count
 }
 
 void B_CopyBufferToStream (buffer_t* buffer, GBYTE* stream) {
-	unsigned long i;
-
-	for (i = 0; i < buffer->size; i++) {
-		stream[i] = ((GBYTE*) buffer->data)[i];
-	}
+	memcpy (stream, buffer->data, buffer->size);
 }
 
 GBOOL B_AppendBuffer (buffer_t* dest, buffer_t* src) {
-	unsigned long i;
-
 	if (dest->index + src->index > dest->allocated) {
 		return GFALSE;
 	}
 
-	for (i = 0; i < src->index; i++, dest->index++) {
-		((GBYTE*) dest->data)[dest->index] = ((GBYTE*) src->data)[i];
-	}
+	memcpy ((GBYTE*) dest->data + dest->index, src->data, src->index);
+	dest->index += src->index;
 
 	if (dest->size < dest->index) {
 		dest->size = dest->index;
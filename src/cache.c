@@ -0,0 +1,316 @@
+#include <stdlib.h>
+#include <string.h>
+#include "cache.h"
+#include "thread.h"
+
+#define CACHEBUCKETS                   256
+
+struct framecache_s {
+	mutex_t*                           lock;               // Guards the cache and the frames in it.
+	cachedframe_t**                    buckets;            // Frames by hash and number.
+	unsigned long                      bucketcount;        // Power of two.
+	unsigned long                      count;              // Frames in the cache.
+	unsigned long                      used;               // Bytes taken by the frames in the cache.
+	unsigned long                      budget;             // Bytes the frames may take.
+	cachedframe_t*                     newest;             // Most recently used frame.
+	cachedframe_t*                     oldest;             // Least recently used frame, evicted first.
+};
+
+/*
+  Creates a cache whose frames take "budget" bytes at most, their bookkeeping
+  included. Frames held while evicted are not counted.
+*/
+
+framecache_t* FC_NewCache (unsigned long budget) {
+	framecache_t* cache;
+
+	if ((cache = (framecache_t*) malloc (sizeof (framecache_t))) == NULL) {
+		return NULL;
+	}
+
+	cache->bucketcount = CACHEBUCKETS;
+	cache->count       = 0;
+	cache->used        = 0;
+	cache->budget      = budget;
+	cache->newest      = NULL;
+	cache->oldest      = NULL;
+
+	if ((cache->buckets = (cachedframe_t**) calloc (cache->bucketcount, sizeof (cachedframe_t*))) == NULL) {
+		goto clean;
+	}
+
+	if ((cache->lock = T_NewMutex ()) == NULL) {
+		goto clean;
+	}
+
+	return cache;
+
+clean:
+	free (cache->buckets);
+	free (cache);
+
+	return NULL;
+}
+
+/*
+  Frees the cache and its frames, which must all have been released.
+*/
+
+void FC_FreeCache (framecache_t* cache) {
+	cachedframe_t* f;
+	cachedframe_t* older;
+
+	if (cache) {
+		for (f = cache->newest; f; f = older) {
+			older = f->older;
+			free (f);
+		}
+
+		T_FreeMutex (cache->lock);
+		free (cache->buckets);
+		free (cache);
+	}
+}
+
+/*
+  64-bit FNV-1a hash of a GIF, to key its frames with.
+*/
+
+unsigned long long FC_Hash (const GBYTE* data, unsigned long size) {
+	unsigned long long h;
+	unsigned long      k;
+
+	h = 0xCBF29CE484222325ULL;
+
+	for (k = 0; k < size; k++) {
+		h ^= data[k];
+		h *= 0x100000001B3ULL;
+	}
+
+	return h;
+}
+
+unsigned long FC_Bucket (framecache_t* cache, unsigned long long hash, unsigned long frame) {
+	return (unsigned long) ((hash ^ (hash >> 32)) + frame * 0x9E3779B1UL) & (cache->bucketcount - 1);
+}
+
+void FC_Unlink (framecache_t* cache, cachedframe_t* f) {
+	if (f->newer) {
+		f->newer->older = f->older;
+	} else {
+		cache->newest = f->older;
+	}
+
+	if (f->older) {
+		f->older->newer = f->newer;
+	} else {
+		cache->oldest = f->newer;
+	}
+}
+
+void FC_LinkNewest (framecache_t* cache, cachedframe_t* f) {
+	f->newer = NULL;
+	f->older = cache->newest;
+
+	if (cache->newest) {
+		cache->newest->newer = f;
+	} else {
+		cache->oldest = f;
+	}
+
+	cache->newest = f;
+}
+
+/*
+  Takes "f" out of the cache. It is freed now if nobody holds it, or on its
+  last release otherwise.
+*/
+
+void FC_Remove (framecache_t* cache, cachedframe_t* f) {
+	cachedframe_t** p;
+
+	for (p = cache->buckets + FC_Bucket (cache, f->hash, f->frame); *p != f; p = &(*p)->next);
+
+	*p = f->next;
+	FC_Unlink (cache, f);
+
+	cache->count--;
+	cache->used -= sizeof (cachedframe_t) + f->size;
+	f->cached    = GFALSE;
+
+	if (f->refs == 0) {
+		free (f);
+	}
+}
+
+/*
+  Doubles the buckets once there are more frames than buckets. The cache works
+  on, only slower, if there is no memory for it.
+*/
+
+void FC_Grow (framecache_t* cache) {
+	cachedframe_t** buckets;
+	cachedframe_t** old;
+	cachedframe_t*  f;
+	cachedframe_t*  next;
+	unsigned long   k, count;
+
+	if ((buckets = (cachedframe_t**) calloc (cache->bucketcount * 2, sizeof (cachedframe_t*))) == NULL) {
+		return;
+	}
+
+	old   = cache->buckets;
+	count = cache->bucketcount;
+
+	cache->buckets      = buckets;
+	cache->bucketcount *= 2;
+
+	for (k = 0; k < count; k++) {
+		for (f = old[k]; f; f = next) {
+			next = f->next;
+			f->next = buckets[FC_Bucket (cache, f->hash, f->frame)];
+			buckets[FC_Bucket (cache, f->hash, f->frame)] = f;
+		}
+	}
+
+	free (old);
+}
+
+cachedframe_t* FC_Find (framecache_t* cache, unsigned long long hash, unsigned long frame) {
+	cachedframe_t* f;
+
+	for (f = cache->buckets[FC_Bucket (cache, hash, frame)]; f; f = f->next) {
+		if (f->hash == hash && f->frame == frame) {
+			return f;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+  Returns frame "frame" of the GIF hashed as "hash", held, or NULL if it is not
+  in the cache. The frame must be released once done with.
+*/
+
+cachedframe_t* FC_Lookup (framecache_t* cache, unsigned long long hash, unsigned long frame) {
+	cachedframe_t* f;
+
+	T_Lock (cache->lock);
+
+	if ((f = FC_Find (cache, hash, frame)) != NULL) {
+		FC_Unlink (cache, f);
+		FC_LinkNewest (cache, f);
+		f->refs++;
+	}
+
+	T_Unlock (cache->lock);
+
+	return f;
+}
+
+/*
+  Copies "size" bytes of "data" into the cache as frame "frame" of the GIF
+  hashed as "hash", evicting the least recently used frames to stay within the
+  budget, and returns it held. If another thread inserted the frame first, its
+  copy is returned instead. A frame larger than the whole budget is returned
+  without being cached.
+*/
+
+cachedframe_t* FC_Insert (framecache_t* cache, unsigned long long hash, unsigned long frame, const GBYTE* data, unsigned long size) {
+	cachedframe_t* f;
+	cachedframe_t* found;
+
+	// Copy outside the lock.
+
+	if ((f = (cachedframe_t*) malloc (sizeof (cachedframe_t) + size)) == NULL) {
+		return NULL;
+	}
+
+	f->data   = (GBYTE*) (f + 1);
+	f->size   = size;
+	f->hash   = hash;
+	f->frame  = frame;
+	f->refs   = 1;
+	f->cached = GFALSE;
+	f->newer  = NULL;
+	f->older  = NULL;
+	f->next   = NULL;
+
+	memcpy (f->data, data, size);
+
+	if (size > cache->budget || cache->budget - size < sizeof (cachedframe_t)) {
+		return f;
+	}
+
+	T_Lock (cache->lock);
+
+	if ((found = FC_Find (cache, hash, frame)) != NULL) {
+		FC_Unlink (cache, found);
+		FC_LinkNewest (cache, found);
+		found->refs++;
+
+		T_Unlock (cache->lock);
+		free (f);
+
+		return found;
+	}
+
+	while (cache->oldest && cache->budget - cache->used < sizeof (cachedframe_t) + size) {
+		FC_Remove (cache, cache->oldest);
+	}
+
+	if (cache->count >= cache->bucketcount) {
+		FC_Grow (cache);
+	}
+
+	f->next   = cache->buckets[FC_Bucket (cache, hash, frame)];
+	f->cached = GTRUE;
+
+	cache->buckets[FC_Bucket (cache, hash, frame)] = f;
+	FC_LinkNewest (cache, f);
+
+	cache->count++;
+	cache->used += sizeof (cachedframe_t) + size;
+
+	T_Unlock (cache->lock);
+
+	return f;
+}
+
+void FC_Release (framecache_t* cache, cachedframe_t* frame) {
+	GBOOL last;
+
+	if (frame == NULL) {
+		return;
+	}
+
+	T_Lock (cache->lock);
+
+	last = (--frame->refs == 0 && !frame->cached) ? GTRUE : GFALSE;
+
+	T_Unlock (cache->lock);
+
+	if (last) {
+		free (frame);
+	}
+}
+
+/*
+  Returns the RGBA pixels of "frame" composited, held, from the cache if there,
+  rendered with FI_DecodeFrame() onto "*canvas" and cached otherwise.
+*/
+
+cachedframe_t* FC_RenderFrame (framecache_t* cache, context_t* ctx, frameindex_t* index, unsigned long long hash, unsigned long frame, canvas_t** canvas) {
+	cachedframe_t* f;
+
+	if ((f = FC_Lookup (cache, hash, frame)) != NULL) {
+		return f;
+	}
+
+	if (!FI_DecodeFrame (ctx, index, frame, canvas)) {
+		return NULL;
+	}
+
+	return FC_Insert (cache, hash, frame, (*canvas)->pixels, (unsigned long) (*canvas)->width * (*canvas)->height * 4);
+}
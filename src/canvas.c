@@ -0,0 +1,229 @@
+#include <stdlib.h>
+#include <string.h>
+#include "canvas.h"
+#include "palette.h"
+
+canvas_t* CV_NewCanvas (gif_t* gif) {
+	canvas_t* canvas;
+
+	if ((canvas = (canvas_t*) malloc (sizeof (canvas_t))) == NULL) {
+		return NULL;
+	}
+
+	canvas->width     = gif->screenwidth;
+	canvas->height    = gif->screenheight;
+	canvas->saved     = NULL;
+	canvas->savedsize = 0;
+
+	if ((canvas->pixels = (GBYTE*) malloc ((unsigned long) canvas->width * canvas->height * 4 + 1)) == NULL) {
+		free (canvas);
+		return NULL;
+	}
+
+	CV_ResetCanvas (canvas);
+
+	return canvas;
+}
+
+void CV_FreeCanvas (canvas_t* canvas) {
+	if (canvas) {
+		free (canvas->pixels);
+		free (canvas->saved);
+		free (canvas);
+	}
+}
+
+/*
+  Clears the canvas to transparent, as before the first image. Used to start
+  over when an animation loops.
+*/
+
+void CV_ResetCanvas (canvas_t* canvas) {
+	memset (canvas->pixels, 0, (unsigned long) canvas->width * canvas->height * 4);
+
+	canvas->disposal    = DISPOSALNONE;
+	canvas->areawidth   = 0;
+	canvas->areaheight  = 0;
+	canvas->dirtyleft   = 0;
+	canvas->dirtytop    = 0;
+	canvas->dirtywidth  = canvas->width;
+	canvas->dirtyheight = canvas->height;
+}
+
+/*
+  Copies the area of the last image between the canvas and "saved", either
+  way.
+*/
+
+void CV_CopyArea (canvas_t* canvas, GBOOL save) {
+	unsigned long y, row;
+	GBYTE*        p;
+	GBYTE*        s;
+
+	// An image off the screen has no area, and may have nothing saved.
+
+	if (canvas->areawidth == 0 || canvas->areaheight == 0) {
+		return;
+	}
+
+	row = (unsigned long) canvas->areawidth * 4;
+	s   = canvas->saved;
+
+	for (y = 0; y < canvas->areaheight; y++, s += row) {
+		p = canvas->pixels + ((unsigned long) (canvas->top + y) * canvas->width + canvas->left) * 4;
+
+		if (save) {
+			memcpy (s, p, row);
+		} else {
+			memcpy (p, s, row);
+		}
+	}
+}
+
+/*
+  Disposes of the last image as its graphic control extension asked.
+*/
+
+void CV_Dispose (canvas_t* canvas) {
+	unsigned long y;
+
+	switch (canvas->disposal) {
+		case DISPOSALBACKGROUND:
+			for (y = 0; y < canvas->areaheight; y++) {
+				memset (canvas->pixels + ((unsigned long) (canvas->top + y) * canvas->width + canvas->left) * 4, 0, (unsigned long) canvas->areawidth * 4);
+			}
+
+			break;
+
+		case DISPOSALPREVIOUS:
+			CV_CopyArea (canvas, GFALSE);
+
+			break;
+
+		default:
+			break;
+	}
+}
+
+/*
+  Composites "image" of "gif" onto the canvas: the last image is disposed of
+  first, then the pixels of "image" that are not transparent are drawn at its
+  offset. Only the area of the two images is touched.
+*/
+
+GBOOL CV_DrawImage (canvas_t* canvas, gif_t* gif, image_t* image) {
+	unsigned int  colors[256];
+	unsigned long y, right, bottom, items;
+	const rgb_t*  table;
+	palette_t*    palette;
+	GBYTE*        saved;
+	UNSIGNED      left, top, width, height, arealeft, areatop;
+
+	if (image->indexes == NULL) {
+		return GFALSE;
+	}
+
+	if (image->lct) {
+		table   = image->lct;
+		items   = image->lctsize;
+		palette = image->palette;
+	} else {
+		table   = gif->gct;
+		items   = gif->gct ? gif->gctsize : 0;
+		palette = gif->gct ? gif->palette : NULL;
+	}
+
+	// Shared palettes come with their table made, only transparency is left
+	// to apply. Indexes past the color table are drawn black.
+
+	if (palette) {
+		memcpy (colors, palette->rgba, sizeof (colors));
+
+		if (image->transparent) {
+			((GBYTE*) (colors + image->trnspindex))[3] = 0x00;
+		}
+	} else {
+		P_MakeTable (colors, table, items, PIXELRGBA, image->transparent, image->trnspindex);
+	}
+
+	// Clip the image to the screen.
+
+	arealeft = image->left < canvas->width ? image->left : canvas->width;
+	areatop  = image->top < canvas->height ? image->top : canvas->height;
+	width    = image->width < canvas->width - arealeft ? image->width : canvas->width - arealeft;
+	height   = image->height < canvas->height - areatop ? image->height : canvas->height - areatop;
+
+	// Make room to keep what is under the image if it has to be restored
+	// afterwards, before anything changes so a failure leaves the canvas as
+	// it was. The old room may still hold the last image's area.
+
+	saved = NULL;
+
+	if (image->disposal == DISPOSALPREVIOUS && (unsigned long) width * height * 4 > canvas->savedsize) {
+		if ((saved = (GBYTE*) malloc ((unsigned long) width * height * 4)) == NULL) {
+			return GFALSE;
+		}
+	}
+
+	// Dispose of the last image. Its area is dirty if it changes.
+
+	CV_Dispose (canvas);
+
+	if (canvas->disposal == DISPOSALBACKGROUND || canvas->disposal == DISPOSALPREVIOUS) {
+		left   = canvas->left;
+		top    = canvas->top;
+		right  = canvas->left + canvas->areawidth;
+		bottom = canvas->top + canvas->areaheight;
+	} else {
+		left   = canvas->width;
+		top    = canvas->height;
+		right  = 0;
+		bottom = 0;
+	}
+
+	if (saved) {
+		free (canvas->saved);
+
+		canvas->saved     = saved;
+		canvas->savedsize = (unsigned long) width * height * 4;
+	}
+
+	canvas->left       = arealeft;
+	canvas->top        = areatop;
+	canvas->areawidth  = width;
+	canvas->areaheight = height;
+	canvas->disposal   = image->disposal;
+
+	if (canvas->disposal == DISPOSALPREVIOUS) {
+		CV_CopyArea (canvas, GTRUE);
+	}
+
+	// Draw the rows of the image that fall on the screen.
+
+	for (y = 0; y < height; y++) {
+		P_DrawRow (colors, (const GBYTE*) image->indexes->data + y * image->width, canvas->pixels + ((unsigned long) (canvas->top + y) * canvas->width + canvas->left) * 4, width, PIXELRGBA);
+	}
+
+	// The dirty rectangle covers both areas.
+
+	if (width > 0 && height > 0) {
+		left   = canvas->left < left ? canvas->left : left;
+		top    = canvas->top < top ? canvas->top : top;
+		right  = (unsigned long) canvas->left + width > right ? (unsigned long) canvas->left + width : right;
+		bottom = (unsigned long) canvas->top + height > bottom ? (unsigned long) canvas->top + height : bottom;
+	}
+
+	if (right > left && bottom > top) {
+		canvas->dirtyleft   = left;
+		canvas->dirtytop    = top;
+		canvas->dirtywidth  = (UNSIGNED) (right - left);
+		canvas->dirtyheight = (UNSIGNED) (bottom - top);
+	} else {
+		canvas->dirtyleft   = 0;
+		canvas->dirtytop    = 0;
+		canvas->dirtywidth  = 0;
+		canvas->dirtyheight = 0;
+	}
+
+	return GTRUE;
+}
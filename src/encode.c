@@ -0,0 +1,864 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gif.h"
+#include "format.h"
+#include "thread.h"
+
+#define HASHBITS                       13
+#define HASHSIZE                       (1 << HASHBITS)
+#define MAXSUBBLOCKSIZE                255
+#define LOOPAPPID                      "NETSCAPE"
+#define LOOPAUTHCODE                   "2.0"
+#define MINSTRIPESIZE                  16384
+
+// Encoder state. The string table maps a string, as the code of its prefix
+// plus its last index, to its code. It is an open addressing hash table twice
+// the size of the code table, so a lookup costs a couple of probes and the
+// whole image is compressed in linear time.
+
+typedef struct encoder_s {
+	MW                                 write;              // Write function over the GIF data stream.
+	void*                              user;               // User data given to "write".
+	unsigned long                      keys[HASHSIZE];     // String keys plus one, zero for free slots.
+	UNSIGNED                           codes[HASHSIZE];    // Code of each string.
+	UNSIGNED                           clearcode;          // Clear code (CC).
+	UNSIGNED                           eoicode;            // End of information (EOI) code.
+	GBYTE                              mincodesize;        // Minimum code size.
+	GBYTE                              codesize;           // Current code size.
+	UNSIGNED                           nextcode;           // Next code to be put in the string table.
+	unsigned long                      acc;                // Bits not yet written.
+	unsigned int                       bits;               // Valid bits in "acc".
+	buffer_t*                          out;                // Bytes of a stripe, or NULL to write sub-blocks.
+	GBYTE                              block[MAXBLOCKSIZE]; // Size byte and data of the sub-block being filled.
+} encoder_t;
+
+// A part of the indexes of an image compressed on its own. Its codes start
+// from a reset string table and end with a CC, or with the EOI code for the
+// last stripe, so stripes can be laid one after the other.
+
+typedef struct stripe_s {
+	const GBYTE*                       indexes;            // First index of the stripe.
+	unsigned long                      count;              // Number of indexes.
+	GBOOL                              last;               // Last stripe of the image.
+	buffer_t*                          out;                // Compressed codes.
+	unsigned long                      bits;               // Bits in "out".
+} stripe_t;
+
+// Stripes shared by the threads compressing them.
+
+typedef struct stripejob_s {
+	stripe_t*                          stripes;            // Stripes to compress.
+	long                               count;              // Number of stripes.
+	volatile long                      next;               // Stripes taken by the threads so far.
+	volatile GBOOL                     failed;             // Some stripe could not be compressed.
+	GBYTE                              mincodesize;        // Minimum code size of the image.
+} stripejob_t;
+
+typedef struct stripeworker_s {
+	stripejob_t*                       job;                // Shared job.
+	thread_t*                          thread;             // Thread running the worker.
+	encoder_t*                         encoder;            // Encoder owned by the worker.
+} stripeworker_t;
+
+// Extensions of a GIF in the order they were read; the lists of the GIF hold
+// the last one read first. Each kind is written up to the next one left.
+
+typedef struct extensions_s {
+	app_t**                            apps;
+	comment_t**                        comments;
+	text_t**                           texts;
+	unsigned long                      appcount;
+	unsigned long                      commentcount;
+	unsigned long                      textcount;
+	unsigned long                      app;                // Next of each kind to write.
+	unsigned long                      comment;
+	unsigned long                      text;
+	GBOOL                              loop;               // A looping application must be made up.
+} extensions_t;
+
+GBOOL GIF_Write (encoder_t* e, const void* data, unsigned long size) {
+	return e->write (e->user, data, size);
+}
+
+void GIF_PutWord (GBYTE* p, UNSIGNED value) {
+	p[0] = (GBYTE) (value & 0xFF);
+	p[1] = (GBYTE) (value >> 8);
+}
+
+/*
+  Writes "size" bytes of "data" as data sub-blocks followed by the block
+  terminator.
+*/
+
+GBOOL GIF_WriteSubBlocks (encoder_t* e, const GBYTE* data, unsigned long size) {
+	unsigned long n;
+	GBYTE         c;
+
+	while (size > 0) {
+		n = size < MAXSUBBLOCKSIZE ? size : MAXSUBBLOCKSIZE;
+		c = (GBYTE) n;
+
+		if (!GIF_Write (e, &c, sizeof (GBYTE)) || !GIF_Write (e, data, n)) {
+			return GFALSE;
+		}
+
+		data += n;
+		size -= n;
+	}
+
+	c = 0;
+
+	return GIF_Write (e, &c, sizeof (GBYTE));
+}
+
+/*
+  Returns the size field of a color table with "items" entries: the table
+  holds 2^(field + 1) entries, the smallest power of two not below "items".
+*/
+
+GBYTE GIF_TableField (UNSIGNED items) {
+	GBYTE field;
+
+	for (field = 0; field < 7 && (2 << field) < items; field++);
+
+	return field;
+}
+
+/*
+  Writes a color table padded with black up to the size given by its field.
+*/
+
+GBOOL GIF_WriteColorTable (encoder_t* e, const rgb_t* table, UNSIGNED items) {
+	GBYTE         pad[MAXCOLORTABLESIZE];
+	unsigned long size;
+
+	size = (2 << GIF_TableField (items)) * sizeof (rgb_t);
+
+	if (!GIF_Write (e, table, items * sizeof (rgb_t))) {
+		return GFALSE;
+	}
+
+	if (size > items * sizeof (rgb_t)) {
+		memset (pad, 0, size - items * sizeof (rgb_t));
+
+		return GIF_Write (e, pad, size - items * sizeof (rgb_t));
+	}
+
+	return GTRUE;
+}
+
+/*
+  Adds one byte of LZW data, writing the sub-block once it is full. Stripes
+  keep their bytes in memory instead.
+*/
+
+GBOOL GIF_PutByte (encoder_t* e, GBYTE c) {
+	if (e->out) {
+		if (!B_ReserveBuffer (e->out, e->out->size + 1)) {
+			return GFALSE;
+		}
+
+		((GBYTE*) e->out->data)[e->out->size++] = c;
+
+		return GTRUE;
+	}
+
+	e->block[++e->block[0]] = c;
+
+	if (e->block[0] == MAXSUBBLOCKSIZE) {
+		if (!GIF_Write (e, e->block, MAXSUBBLOCKSIZE + 1)) {
+			return GFALSE;
+		}
+
+		e->block[0] = 0;
+	}
+
+	return GTRUE;
+}
+
+/*
+  Packs the "count" low bits of "value", least significant bits first.
+*/
+
+GBOOL GIF_PutBits (encoder_t* e, unsigned long value, unsigned int count) {
+	e->acc  |= value << e->bits;
+	e->bits += count;
+
+	while (e->bits >= 8) {
+		if (!GIF_PutByte (e, (GBYTE) (e->acc & 0xFF))) {
+			return GFALSE;
+		}
+
+		e->acc  >>= 8;
+		e->bits  -= 8;
+	}
+
+	return GTRUE;
+}
+
+GBOOL GIF_PutCode (encoder_t* e, UNSIGNED code) {
+	return GIF_PutBits (e, code, e->codesize);
+}
+
+/*
+  Writes the bits left, the last sub-block and the block terminator.
+*/
+
+GBOOL GIF_FlushCodes (encoder_t* e) {
+	if (e->bits > 0) {
+		if (!GIF_PutByte (e, (GBYTE) (e->acc & 0xFF))) {
+			return GFALSE;
+		}
+
+		e->acc  = 0;
+		e->bits = 0;
+	}
+
+	if (e->block[0] > 0) {
+		if (!GIF_Write (e, e->block, e->block[0] + 1)) {
+			return GFALSE;
+		}
+	}
+
+	e->block[0] = 0;
+
+	return GIF_Write (e, e->block, sizeof (GBYTE));
+}
+
+void GIF_ResetStrings (encoder_t* e) {
+	memset (e->keys, 0, sizeof (e->keys));
+
+	e->nextcode = e->eoicode + 1;
+	e->codesize = e->mincodesize + 1;
+}
+
+/*
+  Compresses "count" indexes from a reset string table and ends with a CC,
+  or with the EOI code if "last". The code size grows once the next code to
+  be added no longer fits in it, which is when the decoder, one code behind,
+  grows its own. When the string table is full a CC is written and it starts
+  over.
+*/
+
+GBOOL GIF_CompressRun (encoder_t* e, const GBYTE* indexes, unsigned long count, GBOOL last) {
+	unsigned long i, key, h;
+	UNSIGNED      prefix;
+	GBYTE         c;
+
+	if (count > 0) {
+		if ((prefix = indexes[0]) >= e->clearcode) {
+			return GFALSE;
+		}
+
+		for (i = 1; i < count; i++) {
+			if ((c = indexes[i]) >= e->clearcode) {
+				return GFALSE;
+			}
+
+			// Look for the string "prefix" plus "c".
+
+			key = ((unsigned long) prefix << 8 | c) + 1;
+			h   = ((key * 2654435761UL) & 0xFFFFFFFFUL) >> (32 - HASHBITS);
+
+			while (e->keys[h] != 0 && e->keys[h] != key) {
+				h = (h + 1) & (HASHSIZE - 1);
+			}
+
+			if (e->keys[h] == key) {
+				prefix = e->codes[h];
+				continue;
+			}
+
+			// Not found: write the longest string known and add the new one.
+
+			if (!GIF_PutCode (e, prefix)) {
+				return GFALSE;
+			}
+
+			if (e->nextcode > (1 << e->codesize) - 1 && e->codesize < MAXCODEBITS) {
+				e->codesize++;
+			}
+
+			e->keys[h]  = key;
+			e->codes[h] = e->nextcode++;
+
+			if (e->nextcode == CODETABLESIZE) {
+				if (!GIF_PutCode (e, e->clearcode)) {
+					return GFALSE;
+				}
+
+				GIF_ResetStrings (e);
+			}
+
+			prefix = c;
+		}
+
+		if (!GIF_PutCode (e, prefix)) {
+			return GFALSE;
+		}
+
+		if (e->nextcode > (1 << e->codesize) - 1 && e->codesize < MAXCODEBITS) {
+			e->codesize++;
+		}
+	}
+
+	return GIF_PutCode (e, last ? e->eoicode : e->clearcode);
+}
+
+void GIF_StartEncoder (encoder_t* e, GBYTE mincodesize, buffer_t* out) {
+	e->mincodesize = mincodesize;
+	e->clearcode   = 1 << mincodesize;
+	e->eoicode     = e->clearcode + 1;
+	e->acc         = 0;
+	e->bits        = 0;
+	e->out         = out;
+	e->block[0]    = 0;
+
+	GIF_ResetStrings (e);
+}
+
+void GIF_CompressWorker (void* arg) {
+	stripeworker_t* w;
+	stripejob_t*    job;
+	stripe_t*       stripe;
+	long            k;
+
+	w   = (stripeworker_t*) arg;
+	job = w->job;
+
+	// Take stripes until none is left. The bits of the last byte that are
+	// not filled are left out of "bits".
+
+	while (!job->failed && (k = T_Increment (&job->next) - 1) < job->count) {
+		stripe = job->stripes + k;
+
+		GIF_StartEncoder (w->encoder, job->mincodesize, stripe->out);
+
+		if (!GIF_CompressRun (w->encoder, stripe->indexes, stripe->count, stripe->last)) {
+			job->failed = GTRUE;
+			continue;
+		}
+
+		stripe->bits = stripe->out->size * 8 + w->encoder->bits;
+
+		if (w->encoder->bits > 0 && !GIF_PutByte (w->encoder, (GBYTE) w->encoder->acc)) {
+			job->failed = GTRUE;
+		}
+	}
+}
+
+/*
+  Compresses the indexes in "n" stripes on up to "threads" threads, the
+  calling one included, and lays their codes one after the other behind a
+  leading CC. Each stripe costs a CC and a few codes of compression lost at
+  its start.
+*/
+
+GBOOL GIF_CompressStripes (encoder_t* e, const GBYTE* indexes, unsigned long count, unsigned long n, unsigned int threads) {
+	stripejob_t     job;
+	stripeworker_t* workers;
+	stripe_t*       s;
+	unsigned long   k, i, size;
+	GBOOL           ok;
+
+	if ((job.stripes = (stripe_t*) malloc (n * sizeof (stripe_t))) == NULL) {
+		return GFALSE;
+	}
+
+	if ((workers = (stripeworker_t*) malloc (threads * sizeof (stripeworker_t))) == NULL) {
+		free (job.stripes);
+		return GFALSE;
+	}
+
+	job.count       = (long) n;
+	job.next        = 0;
+	job.failed      = GFALSE;
+	job.mincodesize = e->mincodesize;
+	ok              = GFALSE;
+
+	for (k = 0; k < n; k++) {
+		s          = job.stripes + k;
+		s->indexes = indexes + count / n * k;
+		s->count   = k < n - 1 ? count / n : count - count / n * k;
+		s->last    = k == n - 1 ? GTRUE : GFALSE;
+		s->bits    = 0;
+
+		// Compressed data is seldom larger than half the indexes.
+
+		if ((s->out = B_AllocBuffer (NULL, s->count / 2 + MAXBLOCKSIZE)) == NULL) {
+			job.failed = GTRUE;
+		}
+	}
+
+	for (k = 0; k < threads; k++) {
+		workers[k].job     = &job;
+		workers[k].thread  = NULL;
+		workers[k].encoder = k == 0 ? e : (encoder_t*) malloc (sizeof (encoder_t));
+	}
+
+	// Start the helper threads. If some cannot be started the others, and
+	// this one, do their share.
+
+	for (k = 1; k < threads && !job.failed; k++) {
+		if (workers[k].encoder) {
+			workers[k].thread = T_NewThread (&GIF_CompressWorker, workers + k);
+		}
+	}
+
+	if (!job.failed) {
+		GIF_CompressWorker (workers);
+	}
+
+	for (k = 1; k < threads; k++) {
+		if (workers[k].thread) {
+			T_JoinThread (workers[k].thread);
+		}
+
+		free (workers[k].encoder);
+	}
+
+	if (job.failed) {
+		goto clean;
+	}
+
+	// Stitch the stripes at bit level, then pack them in sub-blocks.
+
+	GIF_StartEncoder (e, job.mincodesize, NULL);
+
+	if (!GIF_PutCode (e, e->clearcode)) {
+		goto clean;
+	}
+
+	for (k = 0; k < n; k++) {
+		s    = job.stripes + k;
+		size = s->bits / 8;
+
+		for (i = 0; i < size; i++) {
+			if (!GIF_PutBits (e, ((GBYTE*) s->out->data)[i], 8)) {
+				goto clean;
+			}
+		}
+
+		if (s->bits % 8 > 0) {
+			if (!GIF_PutBits (e, ((GBYTE*) s->out->data)[size] & ((1 << s->bits % 8) - 1), s->bits % 8)) {
+				goto clean;
+			}
+		}
+	}
+
+	ok = GIF_FlushCodes (e);
+
+clean:
+	for (k = 0; k < n; k++) {
+		B_FreeBuffer (job.stripes[k].out);
+	}
+
+	free (workers);
+	free (job.stripes);
+
+	return ok;
+}
+
+/*
+  Compresses "count" indexes into data sub-blocks. Large images are split in
+  stripes compressed on "threads" threads.
+*/
+
+GBOOL GIF_CompressIndexes (encoder_t* e, const GBYTE* indexes, unsigned long count, unsigned int threads) {
+	unsigned long n;
+
+	n = count / MINSTRIPESIZE < threads ? count / MINSTRIPESIZE : threads;
+
+	if (n > 1) {
+		return GIF_CompressStripes (e, indexes, count, n, n);
+	}
+
+	GIF_StartEncoder (e, e->mincodesize, NULL);
+
+	if (!GIF_PutCode (e, e->clearcode)) {
+		return GFALSE;
+	}
+
+	if (!GIF_CompressRun (e, indexes, count, GTRUE)) {
+		return GFALSE;
+	}
+
+	return GIF_FlushCodes (e);
+}
+
+GBOOL GIF_WriteScreen (encoder_t* e, gif_t* gif) {
+	GBYTE b[HEADERSIZE + LSDSIZE];
+	GBYTE field;
+
+	memcpy (b, "GIF89a", HEADERSIZE);
+
+	GIF_PutWord (b + HEADERSIZE, gif->screenwidth);
+	GIF_PutWord (b + HEADERSIZE + 2, gif->screenheight);
+
+	// The color resolution is taken to be the size of the table.
+
+	if (gif->gct && gif->gctsize > 0) {
+		field                = GIF_TableField (gif->gctsize);
+		b[HEADERSIZE + 4]    = 0x80 | field << 4 | field;
+	} else {
+		b[HEADERSIZE + 4]    = 0x70;
+	}
+
+	b[HEADERSIZE + 5] = gif->bkgindex;
+	b[HEADERSIZE + 6] = gif->aspectratio;
+
+	if (!GIF_Write (e, b, sizeof (b))) {
+		return GFALSE;
+	}
+
+	if (gif->gct && gif->gctsize > 0) {
+		return GIF_WriteColorTable (e, gif->gct, gif->gctsize);
+	}
+
+	return GTRUE;
+}
+
+GBOOL GIF_WriteApplication (encoder_t* e, const GBYTE* appid, const GBYTE* authcode, const GBYTE* data, unsigned long size) {
+	GBYTE b[2 + APPEXTSIZE];
+
+	b[0] = EXTENSIONBLOCK;
+	b[1] = APPLICATIONEXTENSIONLABEL;
+	b[2] = APPLICATIONIDSIZE + APPLICATIONAUTHCODESIZE;
+
+	memcpy (b + 3, appid, APPLICATIONIDSIZE);
+	memcpy (b + 3 + APPLICATIONIDSIZE, authcode, APPLICATIONAUTHCODESIZE);
+
+	if (!GIF_Write (e, b, sizeof (b))) {
+		return GFALSE;
+	}
+
+	return GIF_WriteSubBlocks (e, data, size);
+}
+
+/*
+  Puts the extensions of "gif" in the order they were read. A looping GIF
+  without a looping application, as one built by hand, gets a NETSCAPE2.0
+  extension made up.
+*/
+
+GBOOL GIF_OrderExtensions (extensions_t* x, gif_t* gif) {
+	app_t*        a;
+	comment_t*    c;
+	text_t*       t;
+	unsigned long k;
+
+	x->appcount     = 0;
+	x->commentcount = 0;
+	x->textcount    = 0;
+	x->app          = 0;
+	x->comment      = 0;
+	x->text         = 0;
+	x->loop         = gif->loop;
+
+	for (a = gif->apps; a; a = a->next, x->appcount++) {
+		if (!memcmp (a->appid, LOOPAPPID, APPLICATIONIDSIZE) || !memcmp (a->appid, "ANIMEXTS", APPLICATIONIDSIZE)) {
+			x->loop = GFALSE;
+		}
+	}
+
+	for (c = gif->comments; c; c = c->next, x->commentcount++);
+	for (t = gif->texts; t; t = t->next, x->textcount++);
+
+	x->apps     = (app_t**) malloc (sizeof (app_t*) * (x->appcount + 1));
+	x->comments = (comment_t**) malloc (sizeof (comment_t*) * (x->commentcount + 1));
+	x->texts    = (text_t**) malloc (sizeof (text_t*) * (x->textcount + 1));
+
+	if (x->apps == NULL || x->comments == NULL || x->texts == NULL) {
+		return GFALSE;
+	}
+
+	for (a = gif->apps, k = x->appcount; a; a = a->next) {
+		x->apps[--k] = a;
+	}
+
+	for (c = gif->comments, k = x->commentcount; c; c = c->next) {
+		x->comments[--k] = c;
+	}
+
+	for (t = gif->texts, k = x->textcount; t; t = t->next) {
+		x->texts[--k] = t;
+	}
+
+	return GTRUE;
+}
+
+void GIF_FreeExtensions (extensions_t* x) {
+	free (x->apps);
+	free (x->comments);
+	free (x->texts);
+}
+
+/*
+  Puts a graphic control extension at "p" and returns where it ends.
+*/
+
+GBYTE* GIF_PutGraphicControl (GBYTE* p, UNSIGNED delaytime, GBYTE disposal, GBOOL userinput, GBOOL transparent, GBYTE trnspindex) {
+	p[0] = EXTENSIONBLOCK;
+	p[1] = GRAPHICCONTROLLABEL;
+	p[2] = 4;
+	p[3] = (disposal & 0x07) << 2 | (userinput ? 0x02 : 0x00) | (transparent ? 0x01 : 0x00);
+	GIF_PutWord (p + 4, delaytime);
+	p[6] = transparent ? trnspindex : 0;
+	p[7] = 0;
+
+	return p + 2 + GCESIZE;
+}
+
+GBOOL GIF_WriteComment (encoder_t* e, comment_t* c) {
+	GBYTE b[2];
+
+	b[0] = EXTENSIONBLOCK;
+	b[1] = COMMENTLABEL;
+
+	if (!GIF_Write (e, b, sizeof (b))) {
+		return GFALSE;
+	}
+
+	return GIF_WriteSubBlocks (e, (const GBYTE*) c->comment, strlen (c->comment));
+}
+
+GBOOL GIF_WriteText (encoder_t* e, text_t* t) {
+	GBYTE  b[2 + GCESIZE + 2 + TEXTSIZE];
+	GBYTE* p;
+
+	p = b;
+
+	if (t->delaytime > 0 || t->transparent || t->disposal || t->userinput) {
+		p = GIF_PutGraphicControl (p, t->delaytime, t->disposal, t->userinput, t->transparent, t->trnspindex);
+	}
+
+	p[0] = EXTENSIONBLOCK;
+	p[1] = PLAINTEXTLABEL;
+	p[2] = TEXTSIZE - 1;
+	GIF_PutWord (p + 3, t->left);
+	GIF_PutWord (p + 5, t->top);
+	GIF_PutWord (p + 7, t->width);
+	GIF_PutWord (p + 9, t->height);
+	p[11] = t->cellwidth;
+	p[12] = t->cellheight;
+	p[13] = t->foreground;
+	p[14] = t->background;
+	p    += 2 + TEXTSIZE;
+
+	if (!GIF_Write (e, b, p - b)) {
+		return GFALSE;
+	}
+
+	return GIF_WriteSubBlocks (e, (const GBYTE*) t->text, strlen (t->text));
+}
+
+/*
+  Writes the extensions read before image "image" not written yet: the
+  applications, the looping one made up, the comments, then the plain texts.
+*/
+
+GBOOL GIF_WriteExtensions (encoder_t* e, gif_t* gif, extensions_t* x, unsigned long image) {
+	GBYTE b[3];
+
+	for (; x->app < x->appcount && x->apps[x->app]->image <= image; x->app++) {
+		if (!GIF_WriteApplication (e, x->apps[x->app]->appid, x->apps[x->app]->authcode, x->apps[x->app]->data, x->apps[x->app]->size)) {
+			return GFALSE;
+		}
+	}
+
+	if (x->loop) {
+		b[0] = 1;
+		GIF_PutWord (b + 1, gif->loopcount);
+
+		if (!GIF_WriteApplication (e, (const GBYTE*) LOOPAPPID, (const GBYTE*) LOOPAUTHCODE, b, sizeof (b))) {
+			return GFALSE;
+		}
+
+		x->loop = GFALSE;
+	}
+
+	for (; x->comment < x->commentcount && x->comments[x->comment]->image <= image; x->comment++) {
+		if (!GIF_WriteComment (e, x->comments[x->comment])) {
+			return GFALSE;
+		}
+	}
+
+	for (; x->text < x->textcount && x->texts[x->text]->image <= image; x->text++) {
+		if (!GIF_WriteText (e, x->texts[x->text])) {
+			return GFALSE;
+		}
+	}
+
+	return GTRUE;
+}
+
+GBOOL GIF_WriteImage (encoder_t* e, gif_t* gif, image_t* i, unsigned int threads) {
+	GBYTE         b[2 + GCESIZE + 1 + IMAGEDESCRIPTORSIZE];
+	GBYTE*        p;
+	GBYTE*        rows;
+	UNSIGNED      items;
+	unsigned long count, y;
+	GBOOL         ok;
+
+	count = (unsigned long) i->width * i->height;
+
+	// Images only scanned have nothing to write.
+
+	if (i->indexes == NULL || i->indexes->allocated < count) {
+		return GFALSE;
+	}
+
+	p = b;
+
+	if (i->delaytime > 0 || i->transparent || i->disposal || i->userinput) {
+		p = GIF_PutGraphicControl (p, i->delaytime, i->disposal, i->userinput, i->transparent, i->trnspindex);
+	}
+
+	p[0] = IMAGESEPARATOR;
+	GIF_PutWord (p + 1, i->left);
+	GIF_PutWord (p + 3, i->top);
+	GIF_PutWord (p + 5, i->width);
+	GIF_PutWord (p + 7, i->height);
+	p[9] = (i->interlaced ? 0x40 : 0x00) | (i->sorted ? 0x20 : 0x00);
+
+	if (i->lct && i->lctsize > 0) {
+		p[9] |= 0x80 | GIF_TableField (i->lctsize);
+	}
+
+	p += 1 + IMAGEDESCRIPTORSIZE;
+
+	if (!GIF_Write (e, b, p - b)) {
+		return GFALSE;
+	}
+
+	if (i->lct && i->lctsize > 0) {
+		if (!GIF_WriteColorTable (e, i->lct, i->lctsize)) {
+			return GFALSE;
+		}
+
+		items = i->lctsize;
+	} else {
+		items = gif->gct ? gif->gctsize : 0;
+	}
+
+	// The minimum code size covers the color table in use, or any index
+	// when there is none. It is never below two.
+
+	if (items > 0) {
+		e->mincodesize = GIF_TableField (items) + 1;
+	} else {
+		e->mincodesize = MAXINDEXBITS;
+	}
+
+	if (e->mincodesize < 2) {
+		e->mincodesize = 2;
+	}
+
+	if (!GIF_Write (e, &e->mincodesize, sizeof (GBYTE))) {
+		return GFALSE;
+	}
+
+	if (!i->interlaced) {
+		return GIF_CompressIndexes (e, (const GBYTE*) i->indexes->data, count, threads);
+	}
+
+	// Rows of interlaced images are kept top to bottom, so lay them out in
+	// the order of the passes first.
+
+	if ((rows = (GBYTE*) malloc (count + 1)) == NULL) {
+		return GFALSE;
+	}
+
+	for (y = 0; y < i->height; y++) {
+		memcpy (rows + y * i->width, (const GBYTE*) i->indexes->data + GIF_InterlacedRow (y, i->height) * i->width, i->width);
+	}
+
+	ok = GIF_CompressIndexes (e, rows, count, threads);
+
+	free (rows);
+
+	return ok;
+}
+
+/*
+  Writes "gif" as a GIF89a stream through "w". Images are compressed from
+  their indexes, so a GIF only scanned cannot be written. With more than one
+  thread, large images are compressed in stripes, one per thread, at the cost
+  of a slightly larger stream.
+*/
+
+GBOOL GIF_WriteStream (gif_t* gif, MW w, void* user, unsigned int threads) {
+	encoder_t*    e;
+	extensions_t  x;
+	image_t*      i;
+	unsigned long k;
+	GBYTE         c;
+	GBOOL         ok;
+
+	if (gif == NULL || w == NULL) {
+		return GFALSE;
+	}
+
+	if ((e = (encoder_t*) malloc (sizeof (encoder_t))) == NULL) {
+		return GFALSE;
+	}
+
+	e->write = w;
+	e->user  = user;
+	ok       = GFALSE;
+
+	if (!GIF_OrderExtensions (&x, gif)) {
+		goto clean;
+	}
+
+	if (!GIF_WriteScreen (e, gif)) {
+		goto clean;
+	}
+
+	// Extensions go where they were read among the images.
+
+	for (i = gif->images, k = 0; i; i = i->next, k++) {
+		if (!GIF_WriteExtensions (e, gif, &x, k)) {
+			goto clean;
+		}
+
+		if (!GIF_WriteImage (e, gif, i, threads > 0 ? threads : 1)) {
+			goto clean;
+		}
+	}
+
+	if (!GIF_WriteExtensions (e, gif, &x, (unsigned long) -1)) {
+		goto clean;
+	}
+
+	c  = TRAILER;
+	ok = GIF_Write (e, &c, sizeof (GBYTE));
+
+clean:
+	GIF_FreeExtensions (&x);
+	free (e);
+
+	return ok;
+}
+
+GBOOL GIF_WriteFileStream (void* user, const void* data, unsigned long size) {
+	return fwrite (data, 1, size, (FILE*) user) == size ? GTRUE : GFALSE;
+}
+
+GBOOL GIF_WriteFile (gif_t* gif, const char* path, unsigned int threads) {
+	FILE* f;
+	GBOOL ok;
+
+	if ((f = fopen (path, "wb")) == NULL) {
+		return GFALSE;
+	}
+
+	ok = GIF_WriteStream (gif, &GIF_WriteFileStream, f, threads);
+
+	if (fclose (f) != 0) {
+		ok = GFALSE;
+	}
+
+	return ok;
+}
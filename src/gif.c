@@ -1,19 +1,54 @@
 #include <string.h>
 #include <stdlib.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 #include "gif.h"
-
-#define CODETABLESIZE                  4096
-#define MAXBLOCKSIZE                   256
-#define MAXCODEBITS                    12
-#define MAXCODE                        (2 << MAXCODEBITS - 1)
-#define BUFFERSIZE                     1024
-#define EXTENSIONBLOCK                 0x21
-#define IMAGESEPARATOR                 0x2C
-#define PLAINTEXTLABEL                 0x01
-#define GRAPHICCONTROLLABEL            0xF9
-#define COMMENTLABEL                   0xFE
-#define APPLICATIONEXTENSIONLABEL      0xFF
-#define TRAILER                        0x3B
+#include "format.h"
+#include "palette.h"
+#include "thread.h"
+
+#define NOCODE                         0xFFFF
+#define DECODEIMAGES                   0
+#define DEFERIMAGES                    1
+#define SKIPIMAGES                     2
+#define STREAMIMAGES                   3
+#define STREAMCHUNKSIZE                4096
+#define WINDOWROWS                     8
+#define DEADLINESLICE                  65536
+#define PUSHSCREEN                     0
+#define PUSHGCT                        1
+#define PUSHBLOCK                      2
+#define PUSHLABEL                      3
+#define PUSHGCE                        4
+#define PUSHAPPEXT                     5
+#define PUSHSIZE                       6
+#define PUSHSUBBLOCK                   7
+#define PUSHDESCRIPTOR                 8
+#define PUSHLCT                        9
+#define PUSHCODESIZE                   10
+#define PUSHTEXT                       11
+#define PUSHDONE                       12
+#define PUSHFAILED                     13
+#define SUBBLOCKSKIP                   0
+#define SUBBLOCKCOMMENT                1
+#define SUBBLOCKAPP                    2
+#define SUBBLOCKIMAGE                  3
+#define SUBBLOCKTEXT                   4
+
+// Decode statistics are only kept when built with GIF_STATS. Otherwise the
+// code keeping them compiles to nothing.
+
+#ifdef GIF_STATS
+#define STAT(x)                        x
+#else
+#define STAT(x)
+#endif
 
 // Header.
 
@@ -50,6 +85,7 @@ typedef struct gce_s {
 	UNSIGNED                           delaytime;
 	GBYTE                              tcidx;
 	GBYTE                              blockterm;
+	unsigned long                      offset;             // Offset of the extension in the stream.
 } gce_t;
 
 typedef struct appext_s {
@@ -58,910 +94,3369 @@ typedef struct appext_s {
 	GBYTE                              authcode[3];
 } appext_t;
 
-// Encapsulates a code table.
+typedef struct plaintext_s {
+	GBYTE                              blocksize;
+	UNSIGNED                           left;
+	UNSIGNED                           top;
+	UNSIGNED                           width;
+	UNSIGNED                           height;
+	GBYTE                              cellwidth;
+	GBYTE                              cellheight;
+	GBYTE                              fgindex;
+	GBYTE                              bgindex;
+} plaintext_t;
+
+// Encapsulates a code table entry. A string is stored as the code of its
+// prefix plus its last index, so the whole table lives in one flat array and
+// strings are produced by walking the prefix chain backwards.
 
 typedef struct codetable_s {
-	unsigned long                      length;
-	GBYTE*                             indexes;
+	UNSIGNED                           prefix;             // Code of the string without its last index.
+	UNSIGNED                           length;             // String length.
+	GBYTE                              suffix;             // Last index of the string.
+	GBYTE                              first;              // First index of the string.
 } codetable_t;
 
-typedef struct read_s {
-	UNSIGNED                           code;               // Current code.
-	GBYTE                              bitptr;             // Bit pointer into GBYTE pointed by "byteptr".
-	GBYTE                              codesize;           // Current code size.
-	unsigned long                      totalcodes;         // Total codes of a given code size.
-	unsigned long                      codecount;          // Codes read of a given code size.
-	GBOOL                              blockterm;          // Indicate that the read_code() function read
-	                                                       // the "block terminator" byte.
-} read_t;
+// Bit reader over a span of de-blocked LZW data. Codes are taken from the
+// low bits of a 64-bit accumulator, which is refilled a whole word at a time,
+// so a code costs one shift and one mask. When reading straight from a memory
+// span the data is still split in sub-blocks: "next" then points to the size
+// byte of the following sub-block and the reader hops to it while refilling.
+
+typedef struct bitreader_s {
+	const GBYTE*                       ptr;                // Next byte to load into the accumulator.
+	const GBYTE*                       end;                // End of the current span.
+	const GBYTE*                       next;               // Next sub-block, or NULL for de-blocked data.
+	const GBYTE*                       stop;               // End of the memory span the sub-blocks are in.
+	unsigned long long                 acc;                // Bit accumulator.
+	unsigned int                       bits;               // Valid bits in "acc".
+} bitreader_t;
 
 // All the information respective to the decoding process.
 
 typedef struct decoder_s {
-	read_t                             readinfo;           // Info for read_code() function.
-	codetable_t*                       codetable;          // Code table.
+	bitreader_t                        reader;             // Reader of the de-blocked data.
+	codetable_t                        codetable[CODETABLESIZE]; // Code table.
 	UNSIGNED                           clearcode;          // Clear code (CC).
 	UNSIGNED                           eoicode;            // End of information (EOI) code.
 	GBYTE                              mincodesize;        // Minimum code size.
+	GBYTE                              codesize;           // Current code size.
 	UNSIGNED                           nextcode;           // Next code to be put in the code table.
 	UNSIGNED                           oldcode;            // Previous code.
-	buffer_t*                          block;              // A block of encoded data (size: 0-255).
-	GBYTE                              index;              // Current color index.
-	buffer_t*                          indexes;            // Set of color indexes.
+	GBOOL                              cleared;            // The leading CC was read.
+	GBOOL                              done;               // EOI code was read.
+	UNSIGNED                           width;              // Width of the image.
+	UNSIGNED                           height;             // Height of the image.
+	GBOOL                              interlaced;         // Rows come in the order of the four passes.
+	unsigned long                      pixels;             // Indexes in the image. Buffers may hold more.
+	unsigned long                      base;               // Index held first in the buffer.
+	unsigned long                      limit;              // Decoding pauses past this index.
+	unsigned long long                 deadline;           // Decoding fails past this time, 0 for never.
+	unsigned int                       error;              // Why decoding failed.
+#ifdef GIF_STATS
+	unsigned long long                 codes;              // Counted until collected into the context statistics.
+	unsigned long                      clears;
+	unsigned long                      flushes;
+	unsigned long                      maxstring;
+#endif
 } decoder_t;
 
-// Read and move pointer functions over the GIF data stream.
-
-MS G_Read;
-MSP G_Move;
+// Decoder context. Everything a decode needs lives here, so independent
+// contexts can be used from different threads at the same time. A context
+// reads either through "read" and "move" or straight from a memory span.
+
+struct context_s {
+	MS                                 read;               // Read function over the GIF data stream.
+	MSP                                move;               // Move pointer function over the GIF data stream.
+	void*                              user;               // User data given to "read" and "move".
+	const GBYTE*                       span;               // Memory span, or NULL when reading a stream.
+	unsigned long                      spansize;           // Size of "span".
+	unsigned long                      position;           // Current offset into the span or stream.
+	GBOOL                              mapped;             // "span" is a file mapping owned by the context.
+	unsigned int                       threads;            // Threads decoding images from a span.
+	allocator_t                        allocator;          // Allocator of the GIFs made by the context.
+	decoder_t                          decoder;            // LZW state and code table.
+	buffer_t*                          data;               // De-blocked image data, reused by every image.
+	GBYTE                              scratch[MAXBLOCKSIZE]; // Holds fetched bytes when reading a stream.
+	stats_t                            stats;              // Statistics of the last decode.
+#ifdef GIF_STATS
+	unsigned long long                 started;            // Time the current call started at.
+	unsigned long                      allocated;          // Allocations of the thread when it started.
+#endif
+
+	// Streaming decoder. Every image is decoded into "frame" in turn.
+
+	FS                                 frame;              // Called with each image decoded.
+	RS                                 row;                // Called with each row decoded.
+	void*                              streamuser;         // User data given to "frame" and "row".
+	buffer_t*                          framebuffer;        // Indexes of the image being decoded.
+
+	// Range decoding. Parsing goes on at "start" once the global color table
+	// is read, and stops after "limit" images. Both are 0 to parse it all.
+
+	unsigned long                      start;
+	unsigned long                      limit;
+
+	// Limits of a decode and what it took so far.
+
+	limits_t                           limits;
+	unsigned long long                 decoded;            // Indexes of the images decoded.
+	unsigned long                      extensions;         // Bytes of extension data kept.
+	unsigned long long                 spent;              // Nanoseconds taken by the pushes so far.
+	unsigned int                       error;              // Why the last decode failed.
+	GBOOL                              tolerant;           // Keep what was decoded before a recoverable error.
+	unsigned int                       damage;             // First error recovered from in tolerant mode.
+
+	// Scaled decoding. Images are sampled to fit a screen "scalewidth" by
+	// "scaleheight" pixels, both 0 to decode at full size.
+
+	UNSIGNED                           scalewidth;
+	UNSIGNED                           scaleheight;
+	buffer_t*                          window;             // Rows being decoded.
+	buffer_t*                          scalemap;           // Columns, then rows, sampled from the image.
+
+	// Push parser. Data is pushed in chunks of any size; fixed-size parts
+	// split between chunks are gathered in "hold".
+
+	IS                                 callback;           // Called as images are decoded.
+	GBYTE                              state;              // What the next bytes are.
+	unsigned long                      need;               // Bytes needed by "state".
+	unsigned long                      held;               // Bytes of them already in "hold".
+	GBYTE                              target;             // What the data sub-blocks belong to.
+	gif_t*                             gif;                // Stream being built.
+	image_t*                           last;               // Last image of "gif".
+	image_t*                           current;            // Image whose data is being pushed.
+	unsigned long                      reported;           // Indexes of "last" reported so far.
+	gce_t                              gce;                // Pending graphic control extension.
+	GBOOL                              gceread;            // "gce" is pending.
+	appext_t                           appext;             // Header of the application extension being read.
+	plaintext_t                        text;               // Header of the plain text extension being read.
+	GBYTE                              hold[MAXCOLORTABLESIZE]; // Parts split between chunks.
+};
+
+#ifdef GIF_STATS
+void GIF_ClearCounters (decoder_t* d) {
+	d->codes     = 0;
+	d->clears    = 0;
+	d->flushes   = 0;
+	d->maxstring = 0;
+}
 
-void GIF_FreeImages (image_t* image) {
-	if (image) {
-		if (image->lct) {
-			free (image->lct);
-		}
+/*
+  Adds the counters of "d" to "stats" and clears them.
+*/
 
-		if (image->indexes) {
-			B_FreeBuffer (image->indexes);
-		}
+void GIF_CollectCounters (stats_t* stats, decoder_t* d) {
+	stats->codes   += d->codes;
+	stats->clears  += d->clears;
+	stats->flushes += d->flushes;
 
-		GIF_FreeImages (image->next);
-		free (image);
+	if (stats->maxstring < d->maxstring) {
+		stats->maxstring = d->maxstring;
 	}
-}
 
-void GIF_FreeGif (gif_t* gif) {
-	if (gif->gct) {
-		free (gif->gct);
-	}
+	GIF_ClearCounters (d);
+}
 
-	if (gif->images) {
-		GIF_FreeImages (gif->images);
-	}
+void GIF_StartStats (context_t* ctx) {
+	ctx->started   = T_Time ();
+	ctx->allocated = A_Allocations ();
 }
 
-GBYTE GIF_Min (GBYTE a, GBYTE b) {
-	if (a < b) {
-		return a;
-	} else {
-		return b;
-	}
+void GIF_EndStats (context_t* ctx) {
+	GIF_CollectCounters (&ctx->stats, &ctx->decoder);
+
+	ctx->stats.totaltime   += T_Time () - ctx->started;
+	ctx->stats.allocations += A_Allocations () - ctx->allocated;
 }
 
-long GIF_Max (long a, long b) {
-	if (a > b) {
-		return a;
-	} else {
-		return b;
-	}
+/*
+  Adds the time since "start" to that of image "i".
+*/
+
+void GIF_TimeImage (context_t* ctx, image_t* i, unsigned long long start) {
+	start = T_Time () - start;
+
+	i->decodetime        += start;
+	ctx->stats.decodetime += start;
 }
+#endif
 
-void GIF_FlushTable (codetable_t* codetable, UNSIGNED fixedcodes) {
-	UNSIGNED i;
+/*
+  Fails with "error", unless the reason of the failure is known already.
+*/
 
-	for (i = fixedcodes; i < CODETABLESIZE; i++) {
-		if (codetable[i].indexes) {
-			free (codetable[i].indexes);
-			codetable[i].length = 0;
-			codetable[i].indexes = NULL;
-		} else {
-			break;
-		}
+GBOOL GIF_Fail (context_t* ctx, unsigned int error) {
+	if (ctx->error == ERRORNONE) {
+		ctx->error = error;
 	}
+
+	return GFALSE;
 }
 
-// IMPORTANT: Not all the data contained in "data" must to be initialized.
-// Some members MUST NOT to be initialized and MUST conserve his values.
+/*
+  Errors past which tolerant mode keeps what was decoded.
+*/
 
-void GIF_Init (decoder_t* data) {
-	data->readinfo.code       = 0;
-	data->nextcode            = data->eoicode + 1;
-	data->oldcode             = 0;
-	data->readinfo.codesize   = data->mincodesize + 1;
-	data->readinfo.totalcodes = 1 << data->mincodesize;
-	data->readinfo.codecount  = 1;
-	data->index               = 0;
+GBOOL GIF_Recoverable (unsigned int error) {
+	return error >= ERRORTRUNCATED && error <= ERRORBADBLOCK;
+}
 
-	// Fixed codes are: 2^mincodesize+2.
-	// 2^mincodesize color indexes, CC and EOI.
+/*
+  Why decoding stopped: reading the stream, or else decoding the image.
+*/
 
-	GIF_FlushTable (data->codetable, (1 << data->mincodesize) + 2);
+unsigned int GIF_Error (context_t* ctx) {
+	return ctx->error != ERRORNONE ? ctx->error : ctx->decoder.error;
 }
 
-GBOOL GIF_InitFixedCodes (codetable_t* codetable, UNSIGNED fixedcodes) {
-	UNSIGNED i;
+/*
+  Calls the read and move functions of the stream.
+*/
 
-	for (i = 0; i < fixedcodes; i++) {
-		if ((codetable[i].indexes = (GBYTE*) malloc (sizeof (GBYTE))) == NULL) {
-			return GFALSE;
-		}
+GBOOL GIF_ReadStream (context_t* ctx, void* ptr, unsigned long count) {
+#ifdef GIF_STATS
+	unsigned long long t;
+	GBOOL              ok;
 
-		codetable[i].length = sizeof(GBYTE);
-		codetable[i].indexes[0] = i;
-	}
+	t  = T_Time ();
+	ok = ctx->read (ctx->user, ptr, count);
 
-	return GTRUE;
+	ctx->stats.readtime  += T_Time () - t;
+	ctx->stats.bytesread += count;
+	ctx->stats.reads++;
+
+	return ok;
+#else
+	return ctx->read (ctx->user, ptr, count);
+#endif
 }
 
-buffer_t* GIF_CheckSize (buffer_t* indexes, unsigned long size) {
-	buffer_t* b;
+GBOOL GIF_MoveStream (context_t* ctx, long offset) {
+#ifdef GIF_STATS
+	unsigned long long t;
+	GBOOL              ok;
 
-	if (indexes) {
-		if (indexes->allocated <= size) {
-			if ((b = B_NewBuffer (indexes->allocated + BUFFERSIZE)) == NULL) {
-				return NULL;
-			}
+	t  = T_Time ();
+	ok = ctx->move (ctx->user, offset);
 
-			B_CopyBuffer (b, indexes);
-			B_FreeBuffer (indexes);
+	ctx->stats.readtime += T_Time () - t;
+	ctx->stats.moves++;
+
+	return ok;
+#else
+	return ctx->move (ctx->user, offset);
+#endif
+}
 
-			return b;
+GBOOL GIF_Read (context_t* ctx, void* ptr, unsigned long count) {
+	if (ctx->span) {
+		if (count > ctx->spansize - ctx->position) {
+			return GIF_Fail (ctx, ERRORTRUNCATED);
 		}
 
-		return indexes;
-	} else {
-		return B_NewBuffer (size + BUFFERSIZE);
+		memcpy (ptr, ctx->span + ctx->position, count);
+		ctx->position += count;
+
+		return GTRUE;
+	}
+
+	if (!GIF_ReadStream (ctx, ptr, count)) {
+		return GIF_Fail (ctx, ERRORTRUNCATED);
 	}
+
+	ctx->position += count;
+
+	return GTRUE;
 }
 
 /*
-  Translates a code to a series of indexes and put them into a buffer updating
-  buffer pointer.
+  Returns a pointer to the next "count" bytes (at most MAXBLOCKSIZE) and skips
+  them. From a memory span no copy is made; from a stream the bytes are read
+  into the context scratch, valid until the next fetch.
 */
 
-GBOOL GIF_Translate (UNSIGNED code, codetable_t* codetable, buffer_t* indexes) {
+const GBYTE* GIF_Fetch (context_t* ctx, unsigned long count) {
+	const GBYTE* p;
 
-	// 0xFFF is the maximum code.
+	if (ctx->span) {
+		if (count > ctx->spansize - ctx->position) {
+			GIF_Fail (ctx, ERRORTRUNCATED);
+			return NULL;
+		}
 
-	if (code > MAXCODE) {
-		return GFALSE;
-	}
+		p = ctx->span + ctx->position;
+		ctx->position += count;
 
-	// Check there is valid code.
+		return p;
+	}
 
-	if (!codetable[code].indexes) {
-		return GFALSE;
+	if (!GIF_ReadStream (ctx, ctx->scratch, count)) {
+		GIF_Fail (ctx, ERRORTRUNCATED);
+		return NULL;
 	}
 
-	// Copy all indexes for that code.
+	ctx->position += count;
 
-	return B_CopyStreamToBuffer(indexes, codetable[code].indexes, codetable[code].length);
+	return ctx->scratch;
 }
 
-GBOOL GIF_TranslateSingle (UNSIGNED code, codetable_t* codetable, GBYTE* index) {
-	if (code > MAXCODE) {
-		return GFALSE;
-	}
-
-	if (!codetable[code].indexes || codetable[code].length > 1) {
-		return GFALSE;
-	}
-
-	*index = codetable[code].indexes[0];
+GBOOL GIF_Move (context_t* ctx, long offset) {
+	if (ctx->span) {
+		if (offset < 0 ? (unsigned long) -offset > ctx->position : (unsigned long) offset > ctx->spansize - ctx->position) {
+			return GIF_Fail (ctx, ERRORTRUNCATED);
+		}
 
-	return GTRUE;
-}
+		ctx->position += offset;
 
-GBOOL GIF_ReadCode (read_t* readinfo, buffer_t* block) {
-	UNSIGNED c;
-	GBYTE    cbp;
-	GBYTE    w;
-	GBYTE    bl;
-	GBYTE    size;
-
-	// Check if there is more codes to read with the current code size.
-
-	if (readinfo->totalcodes == readinfo->codecount) {
-		if (readinfo->codesize < MAXCODEBITS) {
-			readinfo->totalcodes = 1 << readinfo->codesize;
-			readinfo->codesize++;
-			readinfo->codecount = 0;
-		}
-	}
-
-	readinfo->code = 0;
-	cbp = 0;
-	bl = readinfo->codesize;
-
-	while (cbp < readinfo->codesize) {
-		// In some GBYTE we have to read the left bits from "bitptr" if this bit amount
-		// is less than "codesize". If there is enough bits to read a code, we read
-		// "codesize" bits.
-		w = GIF_Min (8 - readinfo->bitptr, bl);
-		bl = bl - w;
-		// Move "bitptr" bits to the right and mask the first "w" bits from the right.
-		c = ((GBYTE*) block->data)[block->index]>>readinfo->bitptr & (1 << w) - 1;
-		// The bits in "c" are shifted "cbp" bits to the left. This is for
-		// conserving the bits in "code". Then the bits in "code" and "c" are mixed,
-		// it is the bits in "c" are appended to the bits in "code". Every chunck of
-		// bits added to "code" are more significant than the bits already in "code".
-		readinfo->code ^= c << cbp;
-		// Update pointers.
-		readinfo->bitptr += w;
-		cbp += w;
-		// Time to read a new GBYTE?
-		if (readinfo->bitptr == 8) {
-			block->index++;
-			// Time to read a new block?
-			if (block->index == block->size) {
-				if (!G_Read(&size, sizeof (GBYTE))) {
-					return GFALSE;
-				}
+		return GTRUE;
+	}
 
-				// If size=0 then we read the "block terminator" byte.
-				if (size == 0) {
-					readinfo->blockterm = GTRUE;
-					return GTRUE;
-				}
+	// Without a move function, e.g. on pipes and sockets, skip forward by
+	// reading.
 
-				block->size = 0;
-				block->index = 0;
+	if (ctx->move == NULL) {
+		if (offset < 0) {
+			return GIF_Fail (ctx, ERRORFAILED);
+		}
 
-				if (!B_WriteBuffer (block, G_Read, size)) {
-					return GFALSE;
-				}
+		while (offset > 0) {
+			if (!GIF_Read (ctx, ctx->scratch, offset < MAXBLOCKSIZE ? offset : MAXBLOCKSIZE)) {
+				return GFALSE;
 			}
 
-			readinfo->bitptr = 0;
+			offset -= offset < MAXBLOCKSIZE ? offset : MAXBLOCKSIZE;
 		}
-	}
 
-	// Increment code count.
+		return GTRUE;
+	}
 
-	if (readinfo->codecount < readinfo->totalcodes) {
-		readinfo->codecount++;
+	if (!GIF_MoveStream (ctx, offset)) {
+		return GIF_Fail (ctx, ERRORTRUNCATED);
 	}
 
+	ctx->position += offset;
+
 	return GTRUE;
 }
 
-GBOOL GIF_AddNewCode (codetable_t* codetable, buffer_t* indexes, GBYTE index, UNSIGNED newcode) {
-	if ((codetable[newcode].indexes = (GBYTE*) malloc (indexes->size + sizeof (GBYTE))) == NULL) {
-		return GFALSE;
+/*
+  Moves to "offset" from the start of the stream. Moving back needs a memory
+  span or a move function.
+*/
+
+GBOOL GIF_Seek (context_t* ctx, unsigned long offset) {
+	if (offset >= ctx->position) {
+		return GIF_Move (ctx, (long) (offset - ctx->position));
 	}
 
-	codetable[newcode].length = indexes->size + sizeof (GBYTE);
-	B_CopyBufferToStream (indexes, codetable[newcode].indexes);
-	codetable[newcode].indexes[codetable[newcode].length - 1] = index;
+	return GIF_Move (ctx, -(long) (ctx->position - offset));
+}
 
-	return GTRUE;
+UNSIGNED GIF_Word (const GBYTE* p) {
+	return (UNSIGNED) (p[0] | p[1] << 8);
 }
 
-GBOOL GIF_DecompressData (buffer_t* indexes) {
-	decoder_t d;
-	GBOOL     done;
-	GBYTE     size;
-	long      m;
+/*
+  Returns the palette of "gif" holding the "items" colors of "colors", made if
+  there is none yet, with a reference taken.
+*/
 
-	memset (&d, 0, sizeof (decoder_t));
+palette_t* GIF_InternPalette (gif_t* gif, const GBYTE* colors, unsigned long items) {
+	palette_t*    p;
+	unsigned long hash, k;
 
-	if ((d.codetable = (codetable_t*) malloc (CODETABLESIZE * sizeof (codetable_t))) == NULL) {
-		return GFALSE;
+	for (hash = 2166136261UL, k = 0; k < items * sizeof (rgb_t); k++) {
+		hash = ((hash ^ colors[k]) * 16777619UL) & 0xFFFFFFFFUL;
 	}
 
-	memset (d.codetable, 0, CODETABLESIZE * sizeof (codetable_t));
-
-	if ((d.block = B_NewBuffer (MAXBLOCKSIZE)) == NULL) {
-		goto clean3;
+	for (p = gif->palettes; p; p = p->next) {
+		if (p->hash == hash && p->size == items && !memcmp (p->colors, colors, items * sizeof (rgb_t))) {
+			p->refs++;
+			return p;
+		}
 	}
 
-	if ((d.indexes = B_NewBuffer (BUFFERSIZE)) == NULL) {
-		goto clean2;
+	if ((p = (palette_t*) A_Alloc (&gif->allocator, sizeof (palette_t) + items * sizeof (rgb_t))) == NULL) {
+		return NULL;
 	}
 
-	// Read only once.
-
-	if (!G_Read (&d.mincodesize, sizeof (GBYTE))) {
-		goto clean;
-	}
+	p->colors = (rgb_t*) (p + 1);
+	p->size   = (UNSIGNED) items;
+	p->hash   = hash;
+	p->refs   = 1;
+	p->next   = gif->palettes;
 
-	done                  = GFALSE;
+	memcpy (p->colors, colors, items * sizeof (rgb_t));
+	P_MakeTable (p->rgba, p->colors, items, PIXELRGBA, GFALSE, 0);
 
-	// Initialize
+	gif->palettes = p;
 
-	d.clearcode           = 1 << d.mincodesize;
-	d.eoicode             = d.clearcode + 1;
-	d.readinfo.codesize   = d.mincodesize + 1;
-	d.readinfo.totalcodes = 1 << d.mincodesize;
-	d.readinfo.codecount  = 0;
+	return p;
+}
 
-	// Initialize 2^mincodesize fixed codes, CC and EOI.
+void GIF_ReleasePalette (gif_t* gif, palette_t* palette) {
+	palette_t** p;
 
-	if (!GIF_InitFixedCodes (d.codetable, 1 << d.mincodesize)) {
-		goto clean;
+	if (--palette->refs > 0) {
+		return;
 	}
 
-	// "block.size" is the size of the allocated memory.
-	// "block.index" is the GBYTE where must to be stored the next GBYTE.
+	for (p = &gif->palettes; *p != palette; p = &(*p)->next);
 
-	if (!G_Read (&size, sizeof (GBYTE))) {
-		goto clean;
+	*p = palette->next;
+	A_Free (&gif->allocator, palette);
+}
+
+/*
+  Reads a color table of "items" entries into a palette of "gif".
+*/
+
+palette_t* GIF_ReadPalette (context_t* ctx, gif_t* gif, unsigned long items) {
+	GBYTE      colors[MAXCOLORTABLESIZE];
+	palette_t* p;
+
+	if (!GIF_Read (ctx, colors, items * sizeof (rgb_t))) {
+		return NULL;
 	}
 
-	if (!B_WriteBuffer (d.block, G_Read, size)) {
-		goto clean;
+	if ((p = GIF_InternPalette (gif, colors, items)) == NULL) {
+		GIF_Fail (ctx, ERRORMEMORY);
 	}
 
-	// Read block from first GBYTE.
+	return p;
+}
+
+void GIF_FreeImages (gif_t* gif, image_t* image) {
+	image_t* next;
 
-	d.block->index = 0;
+	while (image) {
+		next = image->next;
 
-	if (!GIF_ReadCode (&d.readinfo, d.block)) {
-		goto clean;
-	}
+		if (image->palette) {
+			GIF_ReleasePalette (gif, image->palette);
+		} else if (image->lct) {
+			A_Free (&gif->allocator, image->lct);
+		}
 
-	// First code read MUST to be the clear code (CC).
+		if (image->indexes) {
+			B_FreeBuffer (image->indexes);
+		}
 
-	if (d.readinfo.code != d.clearcode) {
-		goto clean;
+		A_Free (&gif->allocator, image);
+		image = next;
 	}
+}
 
-	GIF_Init (&d);
+void GIF_FreeGif (gif_t* gif) {
+	allocator_t a;
+	comment_t*  c;
+	text_t*     t;
+	app_t*      p;
 
-	if (!GIF_ReadCode (&d.readinfo, d.block)) {
-		goto clean;
+	if (gif == NULL) {
+		return;
 	}
 
-	d.oldcode = d.readinfo.code;
+	// Memory released all at once by its owner, e.g. an arena, needs no walk.
 
-	if (!GIF_Translate (d.oldcode, d.codetable, indexes)) {
-		goto clean;
+	if (gif->allocator.free == NULL) {
+		return;
 	}
 
-	if (!GIF_TranslateSingle (d.oldcode, d.codetable, &d.index)) {
-		goto clean;
+	a = gif->allocator;
+
+	GIF_FreeImages (gif, gif->images);
+
+	if (gif->palette) {
+		GIF_ReleasePalette (gif, gif->palette);
+	} else if (gif->gct) {
+		A_Free (&a, gif->gct);
 	}
 
-	while (!done) {
-		if (!GIF_ReadCode (&d.readinfo, d.block)) {
-			goto clean;
-		}
+	while (gif->comments) {
+		c = gif->comments->next;
+		A_Free (&a, gif->comments->comment);
+		A_Free (&a, gif->comments);
+		gif->comments = c;
+	}
 
-		// If CC (Clear Code) is founded. Flush table and init all variables.
+	while (gif->texts) {
+		t = gif->texts->next;
+		A_Free (&a, gif->texts->text);
+		A_Free (&a, gif->texts);
+		gif->texts = t;
+	}
 
-		if (d.readinfo.code == d.clearcode) {
-			GIF_Init (&d);
+	while (gif->apps) {
+		p = gif->apps->next;
+		A_Free (&a, gif->apps->data);
+		A_Free (&a, gif->apps);
+		gif->apps = p;
+	}
 
-			if (!GIF_ReadCode (&d.readinfo, d.block)) {
-				goto clean;
-			}
+	A_Free (&a, gif);
+}
 
-			d.oldcode = d.readinfo.code;
+/*
+  Allocates an empty GIF whose memory, and that of everything added to it,
+  comes from "a".
+*/
 
-			if (!GIF_Translate (d.oldcode, d.codetable, indexes)) {
-				goto clean;
-			}
+gif_t* GIF_NewGif (const allocator_t* a) {
+	gif_t* gif;
 
-			if (!GIF_TranslateSingle (d.oldcode, d.codetable, &d.index)) {
-				goto clean;
-			}
-		} else if (d.readinfo.code==d.eoicode) {
+	if ((gif = (gif_t*) A_Alloc (a, sizeof (gif_t))) == NULL) {
+		return NULL;
+	}
 
-			// EOI (END OF INFORMATION) code founded. Decoding process done.
+	memset (gif, 0, sizeof (gif_t));
+	gif->allocator = *a;
 
-			done=GTRUE;
-			break;
-		} else {
+	return gif;
+}
 
-			// Check if a new bigger memory block must to be allocated.
+// IMPORTANT: Not all the data contained in "data" must to be initialized.
+// Some members MUST NOT to be initialized and MUST conserve his values.
 
-			m = GIF_Max (d.codetable[d.readinfo.code].length, d.codetable[d.oldcode].length + sizeof (GBYTE));
+void GIF_Init (decoder_t* data) {
+	data->nextcode = data->eoicode + 1;
+	data->oldcode  = NOCODE;
+	data->codesize = data->mincodesize + 1;
 
-			if ((d.indexes = GIF_CheckSize (d.indexes, m)) == NULL) {
-				goto clean;
-			}
+	// Codes above EOI are simply forgotten: entries are overwritten as the
+	// table grows again, so nothing has to be released.
+}
 
-			// Overwrite existing data.
+void GIF_InitFixedCodes (codetable_t* codetable, UNSIGNED fixedcodes) {
+	UNSIGNED i;
 
-			d.indexes->size  = 0;
-			d.indexes->index = 0;
+	for (i = 0; i < fixedcodes; i++) {
+		codetable[i].prefix = NOCODE;
+		codetable[i].length = 1;
+		codetable[i].suffix = (GBYTE) i;
+		codetable[i].first  = (GBYTE) i;
+	}
+}
 
-			// Exists the code read in the code table?
+/*
+  Returns where the "row"-th row of an interlaced image of "height" rows goes.
+  Rows come in four passes: every 8th row from 0, every 8th from 4, every
+  4th from 2 and every 2nd from 1.
+*/
 
-			if (d.codetable[d.readinfo.code].indexes) {
-				if (!GIF_Translate (d.readinfo.code, d.codetable, d.indexes)) {
-					goto clean;
-				}
-			} else {
-				if (!GIF_Translate (d.oldcode, d.codetable, d.indexes)) {
-					goto clean;
-				}
+unsigned long GIF_InterlacedRow (unsigned long row, UNSIGNED height) {
+	if (row < (unsigned long) (height + 7) / 8) {
+		return row * 8;
+	}
 
-				B_CopyStreamToBuffer (d.indexes, &d.index, sizeof (GBYTE));
-			}
+	row -= (height + 7) / 8;
 
-			// Output decoded indexes.
+	if (row < (unsigned long) (height + 3) / 8) {
+		return row * 8 + 4;
+	}
 
-			if (!B_AppendBuffer (indexes, d.indexes)) {
-				goto clean;
-			}
+	row -= (height + 3) / 8;
 
-			d.index          = ((GBYTE*) d.indexes->data)[0];
-			d.indexes->size  = 0;
-			d.indexes->index = 0;
+	if (row < (unsigned long) (height + 1) / 4) {
+		return row * 4 + 2;
+	}
 
-			if (!GIF_Translate (d.oldcode, d.codetable, d.indexes)) {
-				goto clean;
-			}
+	row -= (height + 1) / 4;
 
-			// Add a new code to the code table.
+	return row * 2 + 1;
+}
 
-			if (!GIF_AddNewCode (d.codetable, d.indexes, d.index, d.nextcode)) {
-				goto clean;
-			}
+/*
+  Translates a code to a series of indexes and put them into a buffer updating
+  buffer pointer. The string is written from its last index to its first one
+  following the prefix chain, straight into the output buffer. Rows of
+  interlaced images are written where they belong, so "indexes->index" counts
+  indexes decoded rather than a position.
+*/
 
-			// We added a new code, so increment the "nextcode".
+GBOOL GIF_Translate (decoder_t* d, UNSIGNED code, buffer_t* indexes) {
+	GBYTE*        p;
+	UNSIGNED      length;
+	unsigned long q, row, n;
 
-			if (d.nextcode < CODETABLESIZE) {
-				d.nextcode++;
-			}
+	length = d->codetable[code].length;
 
-			// Update "oldcode".
+	if (indexes->index + length > d->pixels) {
+		return GFALSE;
+	}
 
-			d.oldcode = d.readinfo.code;
-		}
+#ifdef GIF_STATS
+	if (d->maxstring < length) {
+		d->maxstring = length;
 	}
+#endif
 
-	// Read block terminator if not read by GIF_ReadCode() function.
+	indexes->index += length;
 
-	if (!d.readinfo.blockterm) {
-		if (!G_Read (&d.index, sizeof (GBYTE))) {
-			goto clean;
+	if (!d->interlaced) {
+		p = (GBYTE*) indexes->data + (indexes->index - d->base);
+
+		while (length--) {
+			*--p = d->codetable[code].suffix;
+			code = d->codetable[code].prefix;
 		}
+	} else {
 
-		// Block terminator must be zero.
+		// Write the string row by row, from its end. "q" is the stream
+		// position past the next index to write.
 
-		if (d.index != 0) {
-			goto clean;
+		q = indexes->index;
+
+		while (length > 0) {
+			row     = (q - 1) / d->width;
+			n       = q - row * d->width < length ? q - row * d->width : length;
+			p       = (GBYTE*) indexes->data + GIF_InterlacedRow (row, d->height) * d->width + (q - row * d->width);
+			q      -= n;
+			length -= (UNSIGNED) n;
+
+			while (n--) {
+				*--p = d->codetable[code].suffix;
+				code = d->codetable[code].prefix;
+			}
 		}
 	}
 
-	GIF_FlushTable (d.codetable, 0);
-	free (d.codetable);
-	B_FreeBuffer (d.block);
-	B_FreeBuffer (d.indexes);
+	if (indexes->size < indexes->index) {
+		indexes->size = indexes->index;
+	}
 
 	return GTRUE;
-
-clean:
-	B_FreeBuffer (d.indexes);
-clean2:
-	B_FreeBuffer (d.block);
-clean3:
-	GIF_FlushTable (d.codetable, 0);
-	free (d.codetable);
-
-	return GFALSE;
 }
 
-GBOOL GIF_ReadGraphicControlBlock (GBOOL* gceread, gce_t* gce) {
-	if (*gceread) {
-		return GFALSE;
-	}
+/*
+  Appends one index, following the rows of interlaced images.
+*/
 
-	// Only one graphic control block per graphic rendering block.
+GBOOL GIF_PutIndex (decoder_t* d, GBYTE c, buffer_t* indexes) {
+	unsigned long row;
 
-	if (!G_Read(gce, sizeof (gce_t))) {
+	if (indexes->index >= d->pixels) {
 		return GFALSE;
 	}
 
-	// Block size must to be four and block terminator must to be zero.
-
-	if (!(gce->blocksize == 4 && gce->blockterm == 0)) {
-		return GFALSE;
+	if (d->interlaced) {
+		row = indexes->index / d->width;
+		((GBYTE*) indexes->data)[GIF_InterlacedRow (row, d->height) * d->width + indexes->index - row * d->width] = c;
+	} else {
+		((GBYTE*) indexes->data)[indexes->index - d->base] = c;
 	}
 
-	// Graphic control extension read.
+	indexes->index++;
 
-	*gceread = GTRUE;
+	if (indexes->size < indexes->index) {
+		indexes->size = indexes->index;
+	}
 
 	return GTRUE;
 }
 
-GBOOL GIF_ReadCommentBlock (comment_t** comments) {
-	unsigned long i, commentsize;
-	long          totalbytes;
-	GBYTE         c;
-	comment_t*    comment;
+/*
+  Sets the indexes of "i" left undecoded to "fill". They are not at the end
+  of the buffer for interlaced images.
+*/
 
-	if (!G_Read (&c, sizeof (GBYTE))) {
-		return GFALSE;
-	}
+void GIF_FillUndecoded (image_t* i, GBYTE fill) {
+	buffer_t*     indexes;
+	unsigned long pixels, row, col;
 
-	commentsize = 0;
-	totalbytes = 0;
+	indexes = i->indexes;
+	pixels  = (unsigned long) i->width * i->height;
 
-	while (c != 0) {
-		commentsize += c;
-		totalbytes  += c + sizeof (GBYTE);
+	if (indexes->size >= pixels) {
+		return;
+	}
 
-		// Move stream pointer to the next comment block.
+	if (!i->interlaced) {
+		memset ((GBYTE*) indexes->data + indexes->size, fill, pixels - indexes->size);
+		return;
+	}
 
-		if (!G_Move (c)) {
-			return GFALSE;
-		}
+	for (row = indexes->size / i->width, col = indexes->size % i->width; row < i->height; row++, col = 0) {
+		memset ((GBYTE*) indexes->data + GIF_InterlacedRow (row, i->height) * i->width + col, fill, i->width - col);
+	}
+}
 
-		// Read block size.
+/*
+  Marks "i", whose decoding stopped at an error, as damaged. What was left
+  undecoded is filled with its transparent index, so the image below shows
+  through, or with 0 if it has none.
+*/
 
-		if (!G_Read (&c, sizeof (GBYTE))) {
-			return GFALSE;
-		}
+void GIF_DamageImage (image_t* i) {
+	if (i->indexes) {
+		GIF_FillUndecoded (i, i->transparent ? i->trnspindex : 0);
 	}
 
-	totalbytes++;
+	i->damaged = GTRUE;
+}
 
-	if (commentsize > 0) {
-		if ((comment = (comment_t*) malloc (sizeof (comment_t))) == NULL) {
-			return GFALSE;
-		}
+/*
+  Gives the reader more data, keeping the bits it still holds.
+*/
 
-		comment->next = NULL;
+void GIF_FeedReader (bitreader_t* reader, const GBYTE* data, unsigned long size) {
+	reader->ptr  = data;
+	reader->end  = data + size;
+	reader->next = NULL;
+}
 
-		if ((comment->comment = (char*) malloc (commentsize + 1)) == NULL) {
-			goto clean2;
-		}
+void GIF_InitReader (bitreader_t* reader, const GBYTE* data, unsigned long size) {
+	reader->ptr  = data;
+	reader->end  = data + size;
+	reader->next = NULL;
+	reader->acc  = 0;
+	reader->bits = 0;
+}
 
-		// Move the stream pointer to the starting comment block.
+/*
+  Starts a reader over data sub-blocks in place. "data" points to the size
+  byte of the first sub-block, before "stop". A chain cut short by "stop" is
+  read as far as it goes.
+*/
 
-		if (!G_Move (-totalbytes)) {
-			goto clean;
-		}
+void GIF_InitChainReader (bitreader_t* reader, const GBYTE* data, const GBYTE* stop) {
+	reader->ptr  = data + 1;
+	reader->end  = reader->ptr + (data[0] < stop - reader->ptr ? data[0] : stop - reader->ptr);
+	reader->next = data[0] ? reader->end : NULL;
+	reader->stop = stop;
+	reader->acc  = 0;
+	reader->bits = 0;
+}
 
-		if (!G_Read (&c, sizeof (GBYTE))) {
-			goto clean;
-		}
+/*
+  Tops up the accumulator. While at least eight bytes are left they are loaded
+  with a single little-endian word read; only the tail of a span is loaded
+  byte by byte.
+*/
 
-		// Read the comment blocks and copy it to the new comment.
+void GIF_Refill (bitreader_t* reader) {
+	const GBYTE*       p;
+	unsigned long long w;
 
-		i = 0;
+	p = reader->ptr;
 
-		while (c != 0) {
-			if (!G_Read (comment->comment + i, c)) {
-				goto clean;
-			}
+	if (reader->end - p >= 8) {
+		w = (unsigned long long) p[0]       | (unsigned long long) p[1] << 8  |
+		    (unsigned long long) p[2] << 16 | (unsigned long long) p[3] << 24 |
+		    (unsigned long long) p[4] << 32 | (unsigned long long) p[5] << 40 |
+		    (unsigned long long) p[6] << 48 | (unsigned long long) p[7] << 56;
 
-			i += c;
+		reader->acc  |= w << reader->bits;
+		reader->ptr  += (63 - reader->bits) >> 3;
+		reader->bits |= 56;
+	} else {
+		while (reader->bits <= 56) {
+			if (reader->ptr == reader->end) {
 
-			if (!G_Read (&c, sizeof (GBYTE))) {
-				goto clean;
-			}
-		}
+				// Hop to the next sub-block, if any.
 
-		// End of comment.
+				if (reader->next == NULL || reader->next == reader->stop || *reader->next == 0) {
+					break;
+				}
 
-		*(comment->comment + i) = '\0';
+				reader->ptr  = reader->next + 1;
+				reader->end  = reader->ptr + (*reader->next < reader->stop - reader->ptr ? *reader->next : reader->stop - reader->ptr);
+				reader->next = reader->end;
 
-		if (*comments) {
-			comment->next = *comments;
-		}
+				continue;
+			}
 
-		*comments = comment;
+			reader->acc  |= (unsigned long long) *reader->ptr++ << reader->bits;
+			reader->bits += 8;
+		}
 	}
+}
 
-	return GTRUE;
+/*
+  Reads a "codesize" bits long code. Returns GFALSE when the span is exhausted
+  before a whole code could be read.
+*/
 
-clean:
-	free (comment->comment);
-clean2:
-	free (comment);
+GBOOL GIF_ReadCode (bitreader_t* reader, GBYTE codesize, UNSIGNED* code) {
+	if (reader->bits < codesize) {
+		GIF_Refill (reader);
 
-	return GFALSE;
+		if (reader->bits < codesize) {
+			return GFALSE;
+		}
+	}
+
+	*code          = (UNSIGNED) (reader->acc & ((1 << codesize) - 1));
+	reader->acc  >>= codesize;
+	reader->bits  -= codesize;
+
+	return GTRUE;
 }
 
-GBOOL GIF_ReadApplicationBlock (app_t** apps) {
-	appext_t aext;
-	long     totalbytes;
-	GBYTE    c, n;
-	GBOOL    done;
-	app_t*   app;
+/*
+  Reads data sub-blocks up to and including the block terminator, appending
+  their contents to "data", which may take "room" bytes at most. One read is
+  issued per sub-block, straight into the buffer.
+*/
 
-	if(!G_Read (&aext, sizeof (appext_t))) {
-		return GFALSE;
-	}
+GBOOL GIF_ReadSubBlocks (context_t* ctx, buffer_t* data, unsigned long room) {
+	GBYTE size;
 
-	// Block size must to be 11.
+	while (GTRUE) {
+		if (!GIF_Read (ctx, &size, sizeof (GBYTE))) {
+			return GFALSE;
+		}
 
-	if (aext.blocksize != APPLICATIONIDSIZE + APPLICATIONAUTHCODESIZE) {
-		return GFALSE;
-	}
+		if (size == 0) {
+			return GTRUE;
+		}
 
-	totalbytes = 0;
-	done       = GFALSE;
+		if (size > room - data->size) {
+			return GIF_Fail (ctx, ERRORLIMITEXTENSION);
+		}
 
-	while (!done) {
-		if (!G_Read (&c, sizeof (GBYTE))) {
+		if (!B_ReserveBuffer (data, data->size + size)) {
+			return GIF_Fail (ctx, ERRORMEMORY);
+		}
+
+		if (!GIF_Read (ctx, (GBYTE*) data->data + data->size, size)) {
 			return GFALSE;
 		}
 
-		if (c == 0) {
-			if (!G_Read (&c, sizeof (GBYTE))) {
+		data->size += size;
+	}
+}
+
+void GIF_AddNewCode (codetable_t* codetable, UNSIGNED oldcode, GBYTE index, UNSIGNED newcode) {
+	codetable[newcode].prefix = oldcode;
+	codetable[newcode].length = codetable[oldcode].length + 1;
+	codetable[newcode].suffix = index;
+	codetable[newcode].first  = codetable[oldcode].first;
+}
+
+/*
+  Decodes codes until EOI is read or the reader runs out of data. Indexes are
+  appended to "indexes". Bits left in the reader are kept, so decoding goes on
+  where it stopped once the reader is given more data.
+*/
+
+GBOOL GIF_DecodeCodes (decoder_t* d, buffer_t* indexes) {
+	UNSIGNED code;
+	GBYTE    c;
+
+	while (!d->done && indexes->index <= d->limit && GIF_ReadCode (&d->reader, d->codesize, &code)) {
+		STAT (d->codes++);
+
+		// If CC (Clear Code) is founded. Forget all added codes. First code
+		// read MUST to be the clear code.
+
+		if (code == d->clearcode) {
+			STAT (d->clears++);
+			STAT (d->flushes += d->nextcode > d->eoicode + 1);
+
+			GIF_Init (d);
+			d->cleared = GTRUE;
+		} else if (!d->cleared) {
+			return GFALSE;
+		} else if (code == d->eoicode) {
+
+			// EOI (END OF INFORMATION) code founded. Decoding process done.
+
+			d->done = GTRUE;
+		} else if (d->oldcode == NOCODE) {
+
+			// First code after a CC must be one of the fixed codes.
+
+			if (code >= d->clearcode) {
+				return GFALSE;
+			}
+
+			if (!GIF_Translate (d, code, indexes)) {
 				return GFALSE;
 			}
 
-			if (c == TRAILER || c == EXTENSIONBLOCK) {
+			d->oldcode = code;
+		} else {
 
-				// Go back "totalbytes" + two last bytes read.
+			// Exists the code read in the code table? If not, it must be the
+			// next code to be added: old string plus its own first index.
 
-				if (!G_Move (-totalbytes - 2)) {
+			if (code < d->nextcode) {
+				if (!GIF_Translate (d, code, indexes)) {
 					return GFALSE;
 				}
 
-				done = GTRUE;
-			} else {
+				c = d->codetable[code].first;
+			} else if (code == d->nextcode && d->nextcode < CODETABLESIZE) {
+				if (!GIF_Translate (d, d->oldcode, indexes)) {
+					return GFALSE;
+				}
 
-				// There was no trailer or extension block, so go back one byte.
+				c = d->codetable[d->oldcode].first;
 
-				if (!G_Move (-1)) {
+				if (!GIF_PutIndex (d, c, indexes)) {
 					return GFALSE;
 				}
+			} else {
+				return GFALSE;
+			}
+
+			// Add a new code to the code table. Once the table is full codes
+			// are no longer added until the next CC. Code size grows when the
+			// next code no longer fits in it.
 
-				// Count the last zero read as a application byte.
+			if (d->nextcode < CODETABLESIZE) {
+				GIF_AddNewCode (d->codetable, d->oldcode, c, d->nextcode);
+				d->nextcode++;
 
-				totalbytes++;
+				if (d->nextcode == 1 << d->codesize && d->codesize < MAXCODEBITS) {
+					d->codesize++;
+				}
 			}
-		} else {
-			totalbytes++;
+
+			// Update "oldcode".
+
+			d->oldcode = code;
 		}
 	}
 
-	if (totalbytes > 0) {
-		if ((app = (app_t*) malloc (sizeof (app_t))) == NULL) {
+	return GTRUE;
+}
+
+/*
+  Decodes as GIF_DecodeCodes() does, but a slice of indexes at a time, so the
+  deadline of the decoder is checked while it works. The decoder error tells
+  why it failed.
+*/
+
+GBOOL GIF_DecodeTimed (decoder_t* d, buffer_t* indexes) {
+	unsigned long limit;
+	GBOOL         ok;
+
+	if (d->deadline == 0) {
+		if (!GIF_DecodeCodes (d, indexes)) {
+			d->error = ERRORBADCODE;
 			return GFALSE;
 		}
 
-		app->next = NULL;
+		return GTRUE;
+	}
 
-		if ((app->data = (GBYTE*) malloc (totalbytes)) == NULL) {
-			goto clean2;
-		}
+	limit = d->limit;
 
-		strncpy (app->appid, aext.appid, APPLICATIONIDSIZE);
-		strncpy (app->authcode, aext.authcode, APPLICATIONAUTHCODESIZE);
+	do {
+		d->limit = indexes->index + DEADLINESLICE < limit ? indexes->index + DEADLINESLICE : limit;
+		ok       = GIF_DecodeCodes (d, indexes);
 
-		if (!G_Read (app->data, totalbytes)) {
-			goto clean;
+		if (!ok) {
+			d->error = ERRORBADCODE;
+		} else if (T_Time () > d->deadline) {
+			d->error = ERRORLIMITTIME;
+			ok       = GFALSE;
 		}
+	} while (ok && !d->done && indexes->index > d->limit && d->limit < limit);
 
-		// Skip block terminator.
+	d->limit = limit;
 
-		if (!G_Move (sizeof (GBYTE))) {
-			goto clean;
-		}
+	return ok;
+}
 
-		if (*apps) {
-			app->next = *apps;
-		}
+/*
+  Reads the data sub-blocks of an extension or image, in one forward pass,
+  into the context data buffer, which may take "room" bytes at most.
+*/
 
-		*apps = app;
+GBOOL GIF_ReadBlockData (context_t* ctx, unsigned long room) {
+	if (ctx->data == NULL) {
+		if ((ctx->data = B_NewBuffer (NULL, MAXBLOCKSIZE)) == NULL) {
+			return GIF_Fail (ctx, ERRORMEMORY);
+		}
 	}
 
-	return GTRUE;
-
-clean:
-	free (app->data);
-clean2:
-	free (app);
+	ctx->data->size  = 0;
+	ctx->data->index = 0;
 
-	return GFALSE;
+	return GIF_ReadSubBlocks (ctx, ctx->data, room);
 }
 
-GBOOL GIF_ProcessStream (gif_t** gif, MS r, MSP mp) {
-	header_t          header;
-	lsd_t             lsd;
-	imagedescriptor_t id;
-	gce_t             gce;
-	size_t            items;
-	gif_t*            agif;
-	image_t*          i;
-	image_t*          p;
-	GBYTE             c;
-	GBOOL             done;
-	GBOOL             gceread;
+/*
+  Prepares "d" to decode image "i", whose minimum code size is "mincodesize".
+*/
 
-	if (r == NULL || mp == NULL) {
-		goto clean;
+GBOOL GIF_StartDecoder (decoder_t* d, GBYTE mincodesize, image_t* i) {
+	d->width      = i->width;
+	d->height     = i->height;
+	d->interlaced = i->interlaced;
+	d->pixels     = (unsigned long) i->width * i->height;
+	d->base       = 0;
+	d->limit      = d->pixels;
+
+	if (mincodesize == 0 || mincodesize > MAXINDEXBITS) {
+		d->error = ERRORBADCODE;
+		return GFALSE;
 	}
 
-	G_Read = r;
-	G_Move = mp;
+	d->mincodesize = mincodesize;
+	d->clearcode   = 1 << d->mincodesize;
+	d->eoicode     = d->clearcode + 1;
+	d->cleared     = GFALSE;
+	d->done        = GFALSE;
 
-	if ((agif = (gif_t*) malloc (sizeof (gif_t))) == NULL) {
-		goto clean;
-	}
+	// Initialize 2^mincodesize fixed codes. They never change during the
+	// decoding of a frame.
 
-	memset (agif, 0, sizeof (gif_t));
+	GIF_InitFixedCodes (d->codetable, d->clearcode);
+	GIF_Init (d);
 
-	if (!G_Read (&header, sizeof (header_t))) {
-		goto clean;
-	}
+	return GTRUE;
+}
 
-	if (strncmp (header.signature, "GIF", 3) != 0) {
-		goto clean;
+/*
+  Walks the data sub-blocks starting at "data" and returns a pointer past their
+  block terminator, or NULL if they run beyond "end".
+*/
+
+const GBYTE* GIF_EndOfSubBlocks (const GBYTE* data, const GBYTE* end) {
+	while (data < end && *data != 0) {
+		data += *data + 1;
 	}
 
-	if (strncmp (header.version, "87a", 3) && strncmp (header.version, "89a", 3)) {
-		goto clean;
+	if (data >= end) {
+		return NULL;
 	}
 
-	if (!G_Read (&lsd, sizeof (lsd_t))) {
-		goto clean;
+	return data + 1;
+}
+
+/*
+  Decodes the data of image "i", found at its data offset in a memory span.
+  The span is left untouched, so any number of decoders may work on it at the
+  same time. Data cut short by the end of the span is decoded as far as it
+  goes before failing, so that what there is can be kept.
+*/
+
+GBOOL GIF_DecompressSpan (decoder_t* d, const GBYTE* span, unsigned long size, image_t* i) {
+	unsigned long offset;
+	GBOOL         whole;
+
+	offset = i->dataoffset;
+
+	// The minimum code size and the size of the first sub-block at least.
+
+	if (offset >= size || size - offset < 2) {
+		d->error = ERRORTRUNCATED;
+		return GFALSE;
 	}
 
-	agif->screenwidth  = lsd.width;
-	agif->screenheight = lsd.height;
-	agif->background   = (lsd.pkdfields & 0x80)? GTRUE : GFALSE;
-	agif->bkgindex     = lsd.bkidx;
+	if (!GIF_StartDecoder (d, span[offset], i)) {
+		return GFALSE;
+	}
 
-	// TODO: calculate the aspect ratio if "lsd.par!=0".
+	// Decode the sub-blocks where they are.
 
-	agif->aspectratio  = lsd.par;
+	whole = GIF_EndOfSubBlocks (span + offset + 1, span + size) != NULL;
 
-	// Check Global Color Table existence.
+	GIF_InitChainReader (&d->reader, span + offset + 1, span + size);
 
-	if (lsd.pkdfields & 0x80) {
-		items = 2 << (lsd.pkdfields & 0x07);
+	// A stream without EOI is accepted once its data runs out.
 
-		if ((agif->gct = (rgb_t*) malloc (sizeof (rgb_t) * items)) == NULL) {
-			goto clean;
-		}
+	if (!GIF_DecodeTimed (d, i->indexes)) {
+		return GFALSE;
+	}
 
-		if (!G_Read (agif->gct, sizeof (rgb_t) * items)) {
-			goto clean;
-		}
+	if (!whole) {
+		d->error = ERRORTRUNCATED;
+		return GFALSE;
 	}
 
-	done    = GFALSE;
-	gceread = GFALSE;
+	GIF_FillUndecoded (i, 0);
 
-	while (!done) {
-		if (!G_Read (&c, sizeof (GBYTE))) {
-			goto clean;
-		}
+	return GTRUE;
+}
 
-		switch (c) {
+/*
+  Skips data sub-blocks by their sizes, up to and past the block terminator,
+  without reading them.
+*/
 
-			// Extension block.
+GBOOL GIF_SkipSubBlocks (context_t* ctx) {
+	const GBYTE* p;
+	GBYTE        size;
 
-			case EXTENSIONBLOCK:
-				if (!G_Read (&c, sizeof (GBYTE))) {
-					goto clean;
-				}
+	if (ctx->span) {
+		if ((p = GIF_EndOfSubBlocks (ctx->span + ctx->position, ctx->span + ctx->spansize)) == NULL) {
+			return GIF_Fail (ctx, ERRORTRUNCATED);
+		}
 
-				switch (c) {
+		ctx->position = p - ctx->span;
 
-					// Plain text label.
+		return GTRUE;
+	}
 
-					case PLAINTEXTLABEL:
-						break;
+	do {
+		if (!GIF_Read (ctx, &size, sizeof (GBYTE))) {
+			return GFALSE;
+		}
 
-					// Graphic control label.
+		if (size > 0 && !GIF_Move (ctx, size)) {
+			return GFALSE;
+		}
+	} while (size != 0);
 
-					case GRAPHICCONTROLLABEL:
-						if (!GIF_ReadGraphicControlBlock (&gceread, &gce)) {
-							goto clean;
-						}
+	return GTRUE;
+}
 
-						break;
+/*
+  Skips image data: the minimum code size, then the sub-blocks.
+*/
 
-					// Comment label.
+GBOOL GIF_SkipData (context_t* ctx) {
+	GBYTE mincodesize;
 
-					case COMMENTLABEL:
-						if (!GIF_ReadCommentBlock (&agif->comments)) {
-							goto clean;
-						}
+	if (!GIF_Read (ctx, &mincodesize, sizeof (GBYTE))) {
+		return GFALSE;
+	}
 
-						break;
+	return GIF_SkipSubBlocks (ctx);
+}
 
-					// Application extension label.
+/*
+  Decodes the data of image "i". Data cut short is decoded as far as it goes
+  in tolerant mode, and the decoding then fails.
+*/
 
-					case APPLICATIONEXTENSIONLABEL:
-						if (!GIF_ReadApplicationBlock (&agif->apps)) {
-							goto clean;
-						}
+GBOOL GIF_DecompressData (context_t* ctx, image_t* i) {
+	decoder_t* d;
+	GBYTE      mincodesize;
+	GBOOL      whole;
 
-						break;
+	d = &ctx->decoder;
 
-					default:
-						goto clean;
-				};
+	// The span holds the data whole if it can be skipped.
 
-				break;
+	if (ctx->span) {
+		if (!GIF_SkipData (ctx) && !ctx->tolerant) {
+			return GFALSE;
+		}
 
-			// Image separator.
+		return GIF_DecompressSpan (d, ctx->span, ctx->spansize, i);
+	}
 
-			case IMAGESEPARATOR:
-				if (!G_Read (&id, sizeof (imagedescriptor_t))) {
-					goto clean;
-				}
+	// Read only once.
 
-				if ((i = (image_t*) malloc (sizeof (image_t))) == NULL) {
-					goto clean;
-				}
+	if (!GIF_Read (ctx, &mincodesize, sizeof (GBYTE))) {
+		return GFALSE;
+	}
 
-				memset (i, 0, sizeof (image_t));
+	// Gather all data sub-blocks of the image in one span, so the bit reader
+	// never has to deal with sub-block boundaries. The span is kept by the
+	// context and reused by the next images.
 
-				i->left   = id.left;
-				i->top    = id.top;
-				i->width  = id.width;
-				i->height = id.height;
+	whole = GIF_ReadBlockData (ctx, (unsigned long) -1);
 
-				if (gceread) {
-					i->delaytime = gce.delaytime;
+	if (!whole && (!ctx->tolerant || ctx->error != ERRORTRUNCATED)) {
+		return GFALSE;
+	}
 
-					if (gce.pkdfields & 0x01) {
-						i->transparent = GTRUE;
-						i->trnspindex = gce.tcidx;
-					}
+	if (!GIF_StartDecoder (d, mincodesize, i)) {
+		return GFALSE;
+	}
 
-					// Mark as processed.
+	GIF_InitReader (&d->reader, (GBYTE*) ctx->data->data, ctx->data->size);
 
-					gceread = GFALSE;
-				}
+	// A stream without EOI is accepted once its data runs out. Frame buffers
+	// are not zeroed when allocated, so clear what was left undecoded.
 
-				i->interlaced = (id.pkdfields & 0x40) ? GTRUE : GFALSE;
-				i->sorted     = (id.pkdfields & 0x20) ? GTRUE : GFALSE;
+	if (!GIF_DecodeTimed (d, i->indexes) || !whole) {
+		return GFALSE;
+	}
 
-				// Check Local Color Table existence.
+	GIF_FillUndecoded (i, 0);
 
-				if (id.pkdfields & 0x80) {
-					items = 2 << (id.pkdfields & 0x07);
+	return GTRUE;
+}
 
-					if ((i->lct = (rgb_t*) malloc (sizeof (rgb_t) * items)) == NULL) {
-						goto clean;
-					}
+/*
+  Hands the rows of "i" decoded since the last call, from "*rows" on, to the
+  row function. Rows of interlaced images are handed as their passes fill
+  them.
+*/
 
-					if (!G_Read (i->lct, sizeof (rgb_t) * items)) {
-						goto clean;
-					}
-				}
+GBOOL GIF_StreamRows (context_t* ctx, gif_t* gif, image_t* i, unsigned long* rows, unsigned long count) {
+	unsigned long row;
 
-				i->next = NULL;
+	for (; *rows < count; (*rows)++) {
+		row = i->interlaced ? GIF_InterlacedRow (*rows, i->height) : *rows;
 
-				// This will be filled after decompression.
+		if (!ctx->row (ctx->streamuser, gif, i, (UNSIGNED) row, (const GBYTE*) i->indexes->data + row * i->width)) {
+			return GFALSE;
+		}
+	}
 
-				if ((i->indexes = B_NewBuffer (i->width * i->height)) == NULL) {
-					goto clean;
-				}
+	return GTRUE;
+}
 
-				// Decompress RGB information.
+/*
+  Decodes the data of "i" into its indexes a chunk at a time, handing rows to
+  the row function as soon as they are complete.
+*/
 
-				if (!GIF_DecompressData (i->indexes)) {
-					goto clean;
-				}
+GBOOL GIF_DecompressStreamed (context_t* ctx, gif_t* gif, image_t* i) {
+	decoder_t*    d;
+	unsigned long offset, n, rows;
+	GBYTE         mincodesize;
+	GBOOL         whole, ok;
 
-				// Add image to linked list.
+	d = &ctx->decoder;
 
-				if (agif->images) {
-					p->next = i;
-				} else {
-					agif->images = i;
-				}
+	if (!GIF_Read (ctx, &mincodesize, sizeof (GBYTE))) {
+		return GFALSE;
+	}
 
-				p = i;
+	whole = GIF_ReadBlockData (ctx, (unsigned long) -1);
 
-				break;
+	if (!whole && (!ctx->tolerant || ctx->error != ERRORTRUNCATED)) {
+		return GFALSE;
+	}
 
-			// Trailer.
+	GIF_InitReader (&d->reader, (GBYTE*) ctx->data->data, 0);
 
-			case TRAILER:
-				done = GTRUE;
+	ok   = GIF_StartDecoder (d, mincodesize, i);
+	rows = 0;
 
-				break;
+	for (offset = 0; ok && offset < ctx->data->size && !d->done; offset += n) {
+		n = ctx->data->size - offset < STREAMCHUNKSIZE ? ctx->data->size - offset : STREAMCHUNKSIZE;
 
-			// Any other code is an error.
+		GIF_FeedReader (&d->reader, (GBYTE*) ctx->data->data + offset, n);
 
-			default:
-				goto clean;
+		if (!(ok = GIF_DecodeTimed (d, i->indexes))) {
+			break;
+		}
+
+		if (ctx->row && i->width > 0 && !GIF_StreamRows (ctx, gif, i, &rows, i->indexes->size / i->width)) {
+			return GIF_Fail (ctx, ERRORSTOPPED);
 		}
 	}
 
-	*gif = agif;
+	// Rows left undecoded are handed cleared, or filled as those of a damaged
+	// image in tolerant mode.
 
-	return GTRUE;
+	if (ok && whole) {
+		GIF_FillUndecoded (i, 0);
+	} else if (ctx->tolerant && GIF_Recoverable (GIF_Error (ctx))) {
+		GIF_DamageImage (i);
+	} else {
+		return GFALSE;
+	}
 
-clean:
-	GIF_FreeGif (agif);
+	if (ctx->row && !GIF_StreamRows (ctx, gif, i, &rows, i->height)) {
+		return GIF_Fail (ctx, ERRORSTOPPED);
+	}
 
-	return GFALSE;
+	return ok && whole;
 }
 
+/*
+  Finds the pixels of a screen "scaled" pixels long that sample the "size"
+  pixels from "start" of a screen "screen" pixels long, each pixel being
+  sampled under its center. Their positions in the image are put in "map" and
+  their number is returned; the first of them is put in "first".
+*/
+
+unsigned long GIF_ScaleMap (unsigned long* map, UNSIGNED* first, UNSIGNED start, UNSIGNED size, UNSIGNED screen, UNSIGNED scaled) {
+	unsigned long k, n, source;
+
+	*first = 0;
+
+	for (k = 0, n = 0; k < scaled; k++) {
+		source = ((2 * k + 1) * screen) / (2 * (unsigned long) scaled);
+
+		if (source >= start && source < (unsigned long) start + size) {
+			if (n == 0) {
+				*first = (UNSIGNED) k;
+			}
+
+			map[n++] = source - start;
+		}
+	}
+
+	return n;
+}
+
+/*
+  Samples image row "row" into the output rows taken from it, if any. "rows"
+  tells the image row of each output row, in order.
+*/
+
+void GIF_SampleRow (buffer_t* out, const GBYTE* in, const unsigned long* cols, unsigned long width, const unsigned long* rows, unsigned long height, unsigned long row) {
+	unsigned long lo, hi, mid, x;
+	GBYTE*        p;
+
+	for (lo = 0, hi = height; lo < hi;) {
+		mid = (lo + hi) / 2;
+
+		if (rows[mid] < row) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	for (; lo < height && rows[lo] == row; lo++) {
+		p = (GBYTE*) out->data + lo * width;
+
+		for (x = 0; x < width; x++) {
+			p[x] = in[cols[x]];
+		}
+	}
+}
+
+/*
+  Decodes the data of "i", scaled from a screen "sw" by "sh" pixels to the
+  screen of "gif". The image is decoded a few rows at a time into the window
+  of the context and each row is sampled once complete, so the image is never
+  held at full size. Its position and size become those of the scaled image.
+*/
+
+GBOOL GIF_DecompressScaled (context_t* ctx, gif_t* gif, image_t* i, UNSIGNED sw, UNSIGNED sh) {
+	decoder_t*     d;
+	buffer_t*      w;
+	image_t        source;
+	unsigned long* cols;
+	unsigned long* rows;
+	unsigned long  width, height, row;
+	UNSIGNED       left, top;
+	GBYTE          mincodesize;
+	GBOOL          whole;
+
+	d = &ctx->decoder;
+	w = ctx->window;
+
+	if (!B_ReserveBuffer (ctx->scalemap, ((unsigned long) gif->screenwidth + gif->screenheight) * sizeof (unsigned long))) {
+		return GIF_Fail (ctx, ERRORMEMORY);
+	}
+
+	cols   = (unsigned long*) ctx->scalemap->data;
+	width  = GIF_ScaleMap (cols, &left, i->left, i->width, sw, gif->screenwidth);
+	rows   = cols + width;
+	height = GIF_ScaleMap (rows, &top, i->top, i->height, sh, gif->screenheight);
+
+	// Rows never decoded are left cleared.
+
+	if ((i->indexes = B_NewBuffer (&gif->allocator, width * height)) == NULL) {
+		return GIF_Fail (ctx, ERRORMEMORY);
+	}
+
+	i->indexes->size = width * height;
+
+	// The image is the sampled one from here on, even if decoding fails; the
+	// decoder works on it as it is in the stream.
+
+	source    = *i;
+	i->left   = left;
+	i->top    = top;
+	i->width  = (UNSIGNED) width;
+	i->height = (UNSIGNED) height;
+
+	if (!GIF_Read (ctx, &mincodesize, sizeof (GBYTE))) {
+		return GFALSE;
+	}
+
+	whole = GIF_ReadBlockData (ctx, (unsigned long) -1);
+
+	if (!whole && (!ctx->tolerant || ctx->error != ERRORTRUNCATED)) {
+		return GFALSE;
+	}
+
+	if (!GIF_StartDecoder (d, mincodesize, &source)) {
+		return GFALSE;
+	}
+
+	if (!B_ReserveBuffer (w, (unsigned long) source.width * WINDOWROWS + CODETABLESIZE)) {
+		return GIF_Fail (ctx, ERRORMEMORY);
+	}
+
+	w->size  = 0;
+	w->index = 0;
+
+	// Rows are decoded in the order they come and sampled where they belong.
+
+	d->interlaced = GFALSE;
+
+	GIF_InitReader (&d->reader, (GBYTE*) ctx->data->data, ctx->data->size);
+
+	for (row = 0; row < source.height;) {
+
+		// Pause while a string of the longest length still fits.
+
+		d->limit = d->base + w->allocated - CODETABLESIZE;
+
+		if (!GIF_DecodeTimed (d, w)) {
+			return GFALSE;
+		}
+
+		for (; row < source.height && (row + 1) * source.width <= w->index; row++) {
+			GIF_SampleRow (i->indexes, (GBYTE*) w->data + (row * source.width - d->base), cols, width, rows, height, source.interlaced ? GIF_InterlacedRow (row, source.height) : row);
+		}
+
+		// Out of data, or at the end. What was decoded of the last row is
+		// sampled, the rest of it cleared.
+
+		if (d->done || w->index <= d->limit) {
+			if (row < source.height && w->index > row * source.width) {
+				memset ((GBYTE*) w->data + (w->index - d->base), 0, (row + 1) * source.width - w->index);
+				GIF_SampleRow (i->indexes, (GBYTE*) w->data + (row * source.width - d->base), cols, width, rows, height, source.interlaced ? GIF_InterlacedRow (row, source.height) : row);
+			}
+
+			break;
+		}
+
+		// Move the row being decoded to the start of the window.
+
+		memmove (w->data, (GBYTE*) w->data + (row * source.width - d->base), w->index - row * source.width);
+		d->base = row * source.width;
+	}
+
+	return whole;
+}
+
+// Images shared by the threads decoding them.
+
+typedef struct job_s {
+	const GBYTE*                       span;               // Span holding the image data.
+	unsigned long                      spansize;           // Size of "span".
+	image_t**                          images;             // Images to decode.
+	long                               count;              // Number of images.
+	volatile long                      next;               // Images taken by the threads so far.
+	volatile long                      failed;             // Some image could not be decoded.
+	unsigned long long                 deadline;           // Decoding fails past this time, 0 for never.
+	GBOOL                              tolerant;           // Damaged images do not fail the job.
+} job_t;
+
+typedef struct worker_s {
+	job_t*                             job;                // Shared job.
+	thread_t*                          thread;             // Thread running the worker.
+	decoder_t                          decoder;            // Decoder owned by the worker.
+	unsigned int                       damage;             // First error the worker recovered from.
+} worker_t;
+
+void GIF_DecodeWorker (void* arg) {
+	worker_t* w;
+	job_t*    job;
+	long      k;
+#ifdef GIF_STATS
+	unsigned long long t;
+#endif
+
+	w   = (worker_t*) arg;
+	job = w->job;
+
+	// Take images until none is left.
+
+	while (!T_Load (&job->failed) && (k = T_Increment (&job->next) - 1) < job->count) {
+		STAT (t = T_Time ());
+
+		if (!GIF_DecompressSpan (&w->decoder, job->span, job->spansize, job->images[k])) {
+			if (job->tolerant && GIF_Recoverable (w->decoder.error)) {
+				GIF_DamageImage (job->images[k]);
+
+				if (w->damage == ERRORNONE) {
+					w->damage = w->decoder.error;
+				}
+
+				w->decoder.error = ERRORNONE;
+			} else {
+				T_Store (&job->failed, 1);
+			}
+		}
+
+		STAT (job->images[k]->decodetime = T_Time () - t);
+	}
+}
+
+/*
+  Decodes the data of all images of "gif" using the context threads. Every
+  image must have its buffer allocated and its data offset recorded.
+*/
+
+GBOOL GIF_DecodeImages (context_t* ctx, gif_t* gif) {
+	job_t         job;
+	worker_t*     workers;
+	image_t*      i;
+	unsigned long k, n;
+
+	job.span     = ctx->span;
+	job.spansize = ctx->spansize;
+	job.count    = 0;
+	job.next     = 0;
+	job.failed   = 0;
+	job.deadline = ctx->decoder.deadline;
+	job.tolerant = ctx->tolerant;
+
+	for (i = gif->images; i; i = i->next) {
+		job.count++;
+	}
+
+	if (job.count == 0) {
+		return GTRUE;
+	}
+
+	if ((job.images = (image_t**) malloc (job.count * sizeof (image_t*))) == NULL) {
+		return GIF_Fail (ctx, ERRORMEMORY);
+	}
+
+	for (i = gif->images, k = 0; i; i = i->next, k++) {
+		job.images[k] = i;
+	}
+
+	n = ctx->threads < (unsigned long) job.count ? ctx->threads : (unsigned long) job.count;
+
+	if ((workers = (worker_t*) malloc (n * sizeof (worker_t))) == NULL) {
+		free (job.images);
+		return GIF_Fail (ctx, ERRORMEMORY);
+	}
+
+	// The calling thread is the first worker. If some thread cannot be
+	// created the remaining workers simply take more images.
+
+	for (k = 0; k < n; k++) {
+		workers[k].job    = &job;
+		workers[k].thread = NULL;
+		workers[k].damage = ERRORNONE;
+
+		workers[k].decoder.deadline = job.deadline;
+		workers[k].decoder.error    = ERRORNONE;
+
+		STAT (GIF_ClearCounters (&workers[k].decoder));
+
+		if (k > 0) {
+			workers[k].thread = T_NewThread (&GIF_DecodeWorker, &workers[k]);
+		}
+	}
+
+	GIF_DecodeWorker (&workers[0]);
+
+	for (k = 1; k < n; k++) {
+		T_JoinThread (workers[k].thread);
+	}
+
+	for (k = 0; k < n; k++) {
+		if (ctx->decoder.error == ERRORNONE) {
+			ctx->decoder.error = workers[k].decoder.error;
+		}
+
+		if (ctx->damage == ERRORNONE) {
+			ctx->damage = workers[k].damage;
+		}
+	}
+
+#ifdef GIF_STATS
+	for (k = 0; k < n; k++) {
+		GIF_CollectCounters (&ctx->stats, &workers[k].decoder);
+	}
+
+	for (k = 0; k < (unsigned long) job.count; k++) {
+		ctx->stats.decodetime += job.images[k]->decodetime;
+	}
+#endif
+
+	free (workers);
+	free (job.images);
+
+	return !job.failed;
+}
+
+GBOOL GIF_ParseGraphicControl (context_t* ctx, GBOOL* gceread, gce_t* gce, const GBYTE* p) {
+	gce->blocksize = p[0];
+	gce->pkdfields = p[1];
+	gce->delaytime = GIF_Word (p + 2);
+	gce->tcidx     = p[4];
+	gce->blockterm = p[5];
+
+	// Block size must to be four and block terminator must to be zero.
+
+	if (gce->blocksize != 4) {
+		return GIF_Fail (ctx, ERRORBADBLOCK);
+	}
+
+	if (gce->blockterm != 0) {
+		return GIF_Fail (ctx, ERRORBADTERMINATOR);
+	}
+
+	// Graphic control extension read.
+
+	*gceread = GTRUE;
+
+	return GTRUE;
+}
+
+GBOOL GIF_ReadGraphicControlBlock (context_t* ctx, GBOOL* gceread, gce_t* gce) {
+	const GBYTE* p;
+
+	if (*gceread) {
+		return GIF_Fail (ctx, ERRORBADBLOCK);
+	}
+
+	// The introducer and the label are read already.
+
+	gce->offset = ctx->position - 2;
+
+	// Only one graphic control block per graphic rendering block.
+
+	if ((p = GIF_Fetch (ctx, GCESIZE)) == NULL) {
+		return GFALSE;
+	}
+
+	return GIF_ParseGraphicControl (ctx, gceread, gce, p);
+}
+
+/*
+  Adds a comment holding "size" characters from "text" in front of the
+  comments of "gif".
+*/
+
+GBOOL GIF_NewComment (gif_t* gif, const GBYTE* text, unsigned long size) {
+	comment_t* comment;
+
+	if ((comment = (comment_t*) A_Alloc (&gif->allocator, sizeof (comment_t))) == NULL) {
+		return GFALSE;
+	}
+
+	if ((comment->comment = (char*) A_Alloc (&gif->allocator, size + 1)) == NULL) {
+		A_Free (&gif->allocator, comment);
+		return GFALSE;
+	}
+
+	memcpy (comment->comment, text, size);
+	comment->comment[size] = '\0';
+	comment->image         = gif->imagecount;
+	comment->next          = gif->comments;
+	gif->comments          = comment;
+
+	return GTRUE;
+}
+
+/*
+  Adds an application extension with "size" bytes of "data" in front of the
+  applications of "gif".
+*/
+
+GBOOL GIF_NewApp (gif_t* gif, appext_t* aext, const GBYTE* data, unsigned long size) {
+	app_t* app;
+
+	if ((app = (app_t*) A_Alloc (&gif->allocator, sizeof (app_t))) == NULL) {
+		return GFALSE;
+	}
+
+	if ((app->data = (GBYTE*) A_Alloc (&gif->allocator, size)) == NULL) {
+		A_Free (&gif->allocator, app);
+		return GFALSE;
+	}
+
+	memcpy (app->appid, aext->appid, APPLICATIONIDSIZE);
+	memcpy (app->authcode, aext->authcode, APPLICATIONAUTHCODESIZE);
+	memcpy (app->data, data, size);
+	app->size  = size;
+	app->image = gif->imagecount;
+	app->next  = gif->apps;
+	gif->apps = app;
+
+	return GTRUE;
+}
+
+GBOOL GIF_ParsePlainText (context_t* ctx, plaintext_t* text, const GBYTE* p) {
+	text->blocksize  = p[0];
+	text->left       = GIF_Word (p + 1);
+	text->top        = GIF_Word (p + 3);
+	text->width      = GIF_Word (p + 5);
+	text->height     = GIF_Word (p + 7);
+	text->cellwidth  = p[9];
+	text->cellheight = p[10];
+	text->fgindex    = p[11];
+	text->bgindex    = p[12];
+
+	// Block size must to be 12.
+
+	if (text->blocksize != TEXTSIZE - 1) {
+		return GIF_Fail (ctx, ERRORBADBLOCK);
+	}
+
+	return GTRUE;
+}
+
+/*
+  Adds a plain text holding "size" characters from "text", drawn as "header"
+  tells, in front of the texts of "gif". It takes the pending graphic control
+  extension, if any.
+*/
+
+GBOOL GIF_NewText (gif_t* gif, plaintext_t* header, GBOOL* gceread, gce_t* gce, const GBYTE* text, unsigned long size) {
+	text_t* t;
+
+	if ((t = (text_t*) A_Alloc (&gif->allocator, sizeof (text_t))) == NULL) {
+		return GFALSE;
+	}
+
+	memset (t, 0, sizeof (text_t));
+
+	if ((t->text = (char*) A_Alloc (&gif->allocator, size + 1)) == NULL) {
+		A_Free (&gif->allocator, t);
+		return GFALSE;
+	}
+
+	memcpy (t->text, text, size);
+	t->text[size] = '\0';
+
+	t->left       = header->left;
+	t->top        = header->top;
+	t->width      = header->width;
+	t->height     = header->height;
+	t->cellwidth  = header->cellwidth;
+	t->cellheight = header->cellheight;
+	t->foreground = header->fgindex;
+	t->background = header->bgindex;
+	t->image      = gif->imagecount;
+
+	if (*gceread) {
+		t->delaytime   = gce->delaytime;
+		t->transparent = (gce->pkdfields & 0x01) ? GTRUE : GFALSE;
+		t->trnspindex  = gce->tcidx;
+		t->disposal    = (gce->pkdfields >> 2) & 0x07;
+		t->userinput   = (gce->pkdfields & 0x02) ? GTRUE : GFALSE;
+
+		*gceread = GFALSE;
+	}
+
+	t->next    = gif->texts;
+	gif->texts = t;
+
+	return GTRUE;
+}
+
+/*
+  Bytes of extension data the GIF being decoded may still take.
+*/
+
+unsigned long GIF_ExtensionRoom (context_t* ctx) {
+	if (ctx->limits.extension == 0) {
+		return (unsigned long) -1;
+	}
+
+	return ctx->extensions < ctx->limits.extension ? ctx->limits.extension - ctx->extensions : 0;
+}
+
+GBOOL GIF_ReadCommentBlock (context_t* ctx, gif_t* gif) {
+	if (!GIF_ReadBlockData (ctx, GIF_ExtensionRoom (ctx))) {
+		return GFALSE;
+	}
+
+	if (ctx->data->size == 0) {
+		return GTRUE;
+	}
+
+	ctx->extensions += ctx->data->size;
+
+	return GIF_NewComment (gif, (GBYTE*) ctx->data->data, ctx->data->size) || GIF_Fail (ctx, ERRORMEMORY);
+}
+
+GBOOL GIF_ReadPlainTextBlock (context_t* ctx, gif_t* gif, GBOOL* gceread, gce_t* gce) {
+	plaintext_t  text;
+	const GBYTE* p;
+
+	if ((p = GIF_Fetch (ctx, TEXTSIZE)) == NULL) {
+		return GFALSE;
+	}
+
+	if (!GIF_ParsePlainText (ctx, &text, p)) {
+		return GFALSE;
+	}
+
+	if (!GIF_ReadBlockData (ctx, GIF_ExtensionRoom (ctx))) {
+		return GFALSE;
+	}
+
+	ctx->extensions += ctx->data->size;
+
+	return GIF_NewText (gif, &text, gceread, gce, (GBYTE*) ctx->data->data, ctx->data->size) || GIF_Fail (ctx, ERRORMEMORY);
+}
+
+GBOOL GIF_ReadApplicationBlock (context_t* ctx, gif_t* gif) {
+	appext_t     aext;
+	const GBYTE* p;
+
+	if ((p = GIF_Fetch (ctx, APPEXTSIZE)) == NULL) {
+		return GFALSE;
+	}
+
+	aext.blocksize = p[0];
+	memcpy (aext.appid, p + 1, APPLICATIONIDSIZE);
+	memcpy (aext.authcode, p + 1 + APPLICATIONIDSIZE, APPLICATIONAUTHCODESIZE);
+
+	// Block size must to be 11.
+
+	if (aext.blocksize != APPLICATIONIDSIZE + APPLICATIONAUTHCODESIZE) {
+		return GIF_Fail (ctx, ERRORBADBLOCK);
+	}
+
+	if (!GIF_ReadBlockData (ctx, GIF_ExtensionRoom (ctx))) {
+		return GFALSE;
+	}
+
+	if (ctx->data->size == 0) {
+		return GTRUE;
+	}
+
+	ctx->extensions += ctx->data->size;
+
+	return GIF_NewApp (gif, &aext, (GBYTE*) ctx->data->data, ctx->data->size) || GIF_Fail (ctx, ERRORMEMORY);
+}
+
+context_t* GIF_AllocContext (void) {
+	context_t* ctx;
+
+	if ((ctx = (context_t*) malloc (sizeof (context_t))) == NULL) {
+		return NULL;
+	}
+
+	ctx->read     = NULL;
+	ctx->move     = NULL;
+	ctx->user     = NULL;
+	ctx->span     = NULL;
+	ctx->spansize = 0;
+	ctx->position = 0;
+	ctx->mapped   = GFALSE;
+	ctx->threads  = 1;
+	ctx->data     = NULL;
+	ctx->callback = NULL;
+	ctx->gif      = NULL;
+
+	ctx->frame       = NULL;
+	ctx->row         = NULL;
+	ctx->streamuser  = NULL;
+	ctx->framebuffer = NULL;
+
+	ctx->start = 0;
+	ctx->limit = 0;
+
+	ctx->scalewidth  = 0;
+	ctx->scaleheight = 0;
+	ctx->window      = NULL;
+	ctx->scalemap    = NULL;
+
+	memset (&ctx->stats, 0, sizeof (stats_t));
+	STAT (GIF_ClearCounters (&ctx->decoder));
+
+	memset (&ctx->limits, 0, sizeof (limits_t));
+
+	ctx->decoded          = 0;
+	ctx->extensions       = 0;
+	ctx->spent            = 0;
+	ctx->error            = ERRORNONE;
+	ctx->tolerant         = GFALSE;
+	ctx->damage           = ERRORNONE;
+	ctx->decoder.deadline = 0;
+	ctx->decoder.error    = ERRORNONE;
+
+	A_DefaultAllocator (&ctx->allocator);
+
+	return ctx;
+}
+
+/*
+  Creates a context reading through "r". The stream is only read forward, so
+  "mp" may be NULL for sources that cannot seek; it is used, when given, to
+  skip data faster.
+*/
+
+context_t* GIF_NewContext (MS r, MSP mp, void* user) {
+	context_t* ctx;
+
+	if (r == NULL) {
+		return NULL;
+	}
+
+	if ((ctx = GIF_AllocContext ()) == NULL) {
+		return NULL;
+	}
+
+	ctx->read = r;
+	ctx->move = mp;
+	ctx->user = user;
+
+	return ctx;
+}
+
+/*
+  Creates a context decoding straight from "size" bytes at "data". The data is
+  not copied and must stay valid while the context is used.
+*/
+
+context_t* GIF_NewMemoryContext (const GBYTE* data, unsigned long size) {
+	context_t* ctx;
+
+	if (data == NULL) {
+		return NULL;
+	}
+
+	if ((ctx = GIF_AllocContext ()) == NULL) {
+		return NULL;
+	}
+
+	ctx->span     = data;
+	ctx->spansize = size;
+
+	return ctx;
+}
+
+/*
+  Creates a context decoding from a memory mapping of the file at "path". The
+  mapping is released by GIF_FreeContext().
+*/
+
+context_t* GIF_NewFileContext (const char* path) {
+	context_t*    ctx;
+	void*         view;
+	unsigned long size;
+#ifdef _WIN32
+	HANDLE        file;
+	HANDLE        mapping;
+	LARGE_INTEGER filesize;
+
+	if ((file = CreateFileA (path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL)) == INVALID_HANDLE_VALUE) {
+		return NULL;
+	}
+
+	if (!GetFileSizeEx (file, &filesize) || filesize.QuadPart == 0 || filesize.QuadPart > 0xFFFFFFFF) {
+		CloseHandle (file);
+		return NULL;
+	}
+
+	size    = (unsigned long) filesize.QuadPart;
+	mapping = CreateFileMappingA (file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle (file);
+
+	if (mapping == NULL) {
+		return NULL;
+	}
+
+	view = MapViewOfFile (mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle (mapping);
+
+	if (view == NULL) {
+		return NULL;
+	}
+#else
+	int         fd;
+	struct stat st;
+
+	if ((fd = open (path, O_RDONLY)) < 0) {
+		return NULL;
+	}
+
+	if (fstat (fd, &st) != 0 || st.st_size == 0) {
+		close (fd);
+		return NULL;
+	}
+
+	size = (unsigned long) st.st_size;
+	view = mmap (NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close (fd);
+
+	if (view == MAP_FAILED) {
+		return NULL;
+	}
+#endif
+
+	if ((ctx = GIF_NewMemoryContext ((const GBYTE*) view, size)) == NULL) {
+		goto clean;
+	}
+
+	ctx->mapped = GTRUE;
+
+	return ctx;
+
+clean:
+#ifdef _WIN32
+	UnmapViewOfFile (view);
+#else
+	munmap (view, size);
+#endif
+
+	return NULL;
+}
+
+void GIF_FreeContext (context_t* ctx) {
+	if (ctx) {
+		if (ctx->mapped) {
+#ifdef _WIN32
+			UnmapViewOfFile ((void*) ctx->span);
+#else
+			munmap ((void*) ctx->span, ctx->spansize);
+#endif
+		}
+
+		if (ctx->gif) {
+			GIF_FreeGif (ctx->gif);
+		}
+
+		B_FreeBuffer (ctx->data);
+		B_FreeBuffer (ctx->framebuffer);
+		B_FreeBuffer (ctx->window);
+		B_FreeBuffer (ctx->scalemap);
+		free (ctx);
+	}
+}
+
+/*
+  Sets the allocator of the GIFs made from now on by "ctx", or malloc/free if
+  "a" is NULL. Everything reachable from those GIFs comes from it; the
+  context scratch does not. With an allocator that does not free, such as an
+  arena, GIF_FreeGif() does nothing and the memory is released by its owner.
+*/
+
+void GIF_SetAllocator (context_t* ctx, const allocator_t* a) {
+	if (a) {
+		ctx->allocator = *a;
+	} else {
+		A_DefaultAllocator (&ctx->allocator);
+	}
+}
+
+/*
+  Makes GIF_Decode() and GIF_DecodeRange() scale images to fit a screen
+  "width" by "height" pixels, as thumbnails, sampling the nearest pixel. The
+  GIF then looks as if made at that size: its screen and the position and size
+  of its images are scaled. Only scaled images are ever allocated. A size of 0
+  decodes at full size again.
+*/
+
+GBOOL GIF_SetScale (context_t* ctx, UNSIGNED width, UNSIGNED height) {
+	if ((width == 0) != (height == 0)) {
+		return GFALSE;
+	}
+
+	// Each buffer is made on its own, so a call failing halfway is retried
+	// whole by the next one.
+
+	if (width > 0 && ctx->window == NULL) {
+		if ((ctx->window = B_AllocBuffer (NULL, MAXBLOCKSIZE)) == NULL) {
+			return GFALSE;
+		}
+	}
+
+	if (width > 0 && ctx->scalemap == NULL) {
+		if ((ctx->scalemap = B_AllocBuffer (NULL, MAXBLOCKSIZE)) == NULL) {
+			return GFALSE;
+		}
+	}
+
+	ctx->scalewidth  = width;
+	ctx->scaleheight = height;
+
+	return GTRUE;
+}
+
+/*
+  Copies the statistics of the last decode of "ctx", or of every push so far,
+  into "stats". Returns GFALSE, with them all 0, if the library was built
+  without GIF_STATS.
+*/
+
+GBOOL GIF_GetStats (context_t* ctx, stats_t* stats) {
+	*stats = ctx->stats;
+
+#ifdef GIF_STATS
+	return GTRUE;
+#else
+	return GFALSE;
+#endif
+}
+
+/*
+  Sets the limits the decodes of "ctx" must keep within. Limits set on a push
+  context hold from the next push on.
+*/
+
+void GIF_SetLimits (context_t* ctx, const limits_t* limits) {
+	ctx->limits = *limits;
+}
+
+/*
+  Sets whether the decodes of "ctx" keep what was decoded before a damaged or
+  truncated part of the stream, instead of failing. The images reached are
+  returned, the one hit marked damaged; a bad code only damages its image and
+  parsing goes on past it.
+*/
+
+void GIF_SetTolerant (context_t* ctx, GBOOL tolerant) {
+	ctx->tolerant = tolerant;
+}
+
+/*
+  Returns why the last decode of "ctx", or the last push, failed: one of the
+  ERROR constants, ERRORNONE if it did not. A decode that succeeded in
+  tolerant mode returns the first error it recovered from.
+*/
+
+unsigned int GIF_GetError (context_t* ctx) {
+	return ctx->error != ERRORNONE ? ctx->error : ctx->damage;
+}
+
+/*
+  Sets how many threads decode images. Images are independent once their data
+  is located, so with more than one thread a context reading from a memory
+  span first parses the whole stream and then decodes all images at once.
+  Contexts reading through stream functions always decode sequentially.
+*/
+
+void GIF_SetThreads (context_t* ctx, unsigned int threads) {
+	ctx->threads = threads > 0 ? threads : 1;
+}
+
+/*
+  Checks the header and fills "gif" from the logical screen descriptor, both
+  found in "b". The size of the global color table is returned in "items",
+  zero if there is none.
+*/
+
+GBOOL GIF_ParseScreen (context_t* ctx, gif_t* gif, const GBYTE* b, unsigned long* items) {
+	header_t header;
+	lsd_t    lsd;
+
+	memcpy (header.signature, b, 3);
+	memcpy (header.version, b + 3, 3);
+
+	if (strncmp (header.signature, "GIF", 3) != 0) {
+		return GIF_Fail (ctx, ERRORNOTGIF);
+	}
+
+	if (strncmp (header.version, "87a", 3) && strncmp (header.version, "89a", 3)) {
+		return GIF_Fail (ctx, ERRORUNSUPPORTED);
+	}
+
+	b += HEADERSIZE;
+
+	lsd.width     = GIF_Word (b);
+	lsd.height    = GIF_Word (b + 2);
+	lsd.pkdfields = b[4];
+	lsd.bkidx     = b[5];
+	lsd.par       = b[6];
+
+	gif->screenwidth  = lsd.width;
+	gif->screenheight = lsd.height;
+	gif->background   = (lsd.pkdfields & 0x80)? GTRUE : GFALSE;
+	gif->bkgindex     = lsd.bkidx;
+
+	// TODO: calculate the aspect ratio if "lsd.par!=0".
+
+	gif->aspectratio  = lsd.par;
+
+	// Check Global Color Table existence.
+
+	*items = (lsd.pkdfields & 0x80) ? 2 << (lsd.pkdfields & 0x07) : 0;
+	gif->gctsize = (UNSIGNED) *items;
+
+	return GTRUE;
+}
+
+/*
+  Creates an image from the image descriptor in "b" and the pending graphic
+  control extension, if any, and appends it to the images of "gif". The size
+  of the local color table is returned in "items", zero if there is none.
+*/
+
+image_t* GIF_NewImage (gif_t* gif, image_t** last, const GBYTE* b, GBOOL* gceread, gce_t* gce, unsigned long* items) {
+	imagedescriptor_t id;
+	image_t*          i;
+
+	id.left      = GIF_Word (b);
+	id.top       = GIF_Word (b + 2);
+	id.width     = GIF_Word (b + 4);
+	id.height    = GIF_Word (b + 6);
+	id.pkdfields = b[8];
+
+	if ((i = (image_t*) A_Alloc (&gif->allocator, sizeof (image_t))) == NULL) {
+		return NULL;
+	}
+
+	memset (i, 0, sizeof (image_t));
+
+	i->left   = id.left;
+	i->top    = id.top;
+	i->width  = id.width;
+	i->height = id.height;
+
+	if (*gceread) {
+		i->delaytime = gce->delaytime;
+
+		if (gce->pkdfields & 0x01) {
+			i->transparent = GTRUE;
+			i->trnspindex = gce->tcidx;
+		}
+
+		i->disposal  = (gce->pkdfields >> 2) & 0x07;
+		i->userinput = (gce->pkdfields & 0x02) ? GTRUE : GFALSE;
+		i->gceoffset = gce->offset;
+
+		// Mark as processed.
+
+		*gceread = GFALSE;
+	}
+
+	i->interlaced = (id.pkdfields & 0x40) ? GTRUE : GFALSE;
+	i->sorted     = (id.pkdfields & 0x20) ? GTRUE : GFALSE;
+	i->next       = NULL;
+
+	// Check Local Color Table existence.
+
+	*items = (id.pkdfields & 0x80) ? 2 << (id.pkdfields & 0x07) : 0;
+	i->lctsize = (UNSIGNED) *items;
+
+	// Add image to linked list.
+
+	if (gif->images) {
+		(*last)->next = i;
+	} else {
+		gif->images = i;
+	}
+
+	*last = i;
+	gif->imagecount++;
+
+	return i;
+}
+
+/*
+  Checks the screen of "gif", just read, against the limits of "ctx".
+*/
+
+GBOOL GIF_CheckScreen (context_t* ctx, gif_t* gif) {
+	if (ctx->limits.pixels > 0 && (unsigned long) gif->screenwidth * gif->screenheight > ctx->limits.pixels) {
+		ctx->error = ERRORLIMITPIXELS;
+		return GFALSE;
+	}
+
+	return GTRUE;
+}
+
+/*
+  Checks image "i" of "gif", just described, against the limits of "ctx".
+  Its indexes count against the bytes decoded if it is to be decoded.
+*/
+
+GBOOL GIF_CheckImage (context_t* ctx, gif_t* gif, image_t* i, GBOOL decode) {
+	unsigned long pixels;
+
+	pixels = (unsigned long) i->width * i->height;
+
+	if (ctx->limits.frames > 0 && gif->imagecount > ctx->limits.frames) {
+		ctx->error = ERRORLIMITFRAMES;
+		return GFALSE;
+	}
+
+	if (ctx->limits.pixels > 0 && pixels > ctx->limits.pixels) {
+		ctx->error = ERRORLIMITPIXELS;
+		return GFALSE;
+	}
+
+	if (decode) {
+		ctx->decoded += pixels;
+
+		if (ctx->limits.bytes > 0 && ctx->decoded > ctx->limits.bytes) {
+			ctx->error = ERRORLIMITBYTES;
+			return GFALSE;
+		}
+	}
+
+	return GTRUE;
+}
+
+/*
+  Starts the clock of a decode, or of a push, against the time limit.
+*/
+
+void GIF_StartDeadline (context_t* ctx) {
+	unsigned long long budget;
+
+	ctx->decoder.deadline = 0;
+
+	if (ctx->limits.milliseconds > 0) {
+		budget = (unsigned long long) ctx->limits.milliseconds * 1000000;
+
+		ctx->decoder.deadline = T_Time () + (ctx->spent < budget ? budget - ctx->spent : 0);
+	}
+}
+
+/*
+  Tells why "ctx" failed, if nothing more precise was told already.
+*/
+
+void GIF_SetFailed (context_t* ctx) {
+	if (ctx->error == ERRORNONE) {
+		ctx->error = ctx->decoder.error != ERRORNONE ? ctx->decoder.error : ERRORFAILED;
+	}
+}
+
+/*
+  Called once decoding image "i" failed. In tolerant mode, a recoverable error
+  damages the image. Only a bad code leaves the stream readable past the
+  image: it is recovered from and GTRUE returned so parsing goes on.
+*/
+
+GBOOL GIF_Tolerate (context_t* ctx, image_t* i) {
+	if (!ctx->tolerant || !GIF_Recoverable (GIF_Error (ctx))) {
+		return GFALSE;
+	}
+
+	GIF_DamageImage (i);
+
+	if (ctx->error != ERRORNONE || ctx->decoder.error != ERRORBADCODE) {
+		return GFALSE;
+	}
+
+	if (ctx->damage == ERRORNONE) {
+		ctx->damage = ERRORBADCODE;
+	}
+
+	ctx->decoder.error = ERRORNONE;
+
+	return GTRUE;
+}
+
+/*
+  Takes "i", the last image of "gif", out of it.
+*/
+
+void GIF_DropImage (gif_t* gif, image_t* i) {
+	image_t** p;
+
+	for (p = &gif->images; *p && *p != i; p = &(*p)->next);
+
+	if (*p) {
+		*p = NULL;
+		gif->imagecount--;
+		GIF_FreeImages (gif, i);
+	}
+}
+
+/*
+  Reads the loop count from a NETSCAPE2.0 (or ANIMEXTS1.0) application
+  extension, whose data is 1 followed by a 16-bit loop count.
+*/
+
+void GIF_ReadLoopCount (gif_t* gif, app_t* app) {
+	if (memcmp (app->appid, "NETSCAPE", APPLICATIONIDSIZE) && memcmp (app->appid, "ANIMEXTS", APPLICATIONIDSIZE)) {
+		return;
+	}
+
+	if (app->size >= 3 && app->data[0] == 1) {
+		gif->loop      = GTRUE;
+		gif->loopcount = GIF_Word (app->data + 1);
+	}
+}
+
+/*
+  Parses the whole stream. "mode" tells what to do with image data: decode it
+  at once, allocate image buffers and decode it after parsing, or skip it.
+*/
+
+GBOOL GIF_Parse (context_t* ctx, gif_t** gif, GBYTE mode) {
+	gce_t             gce;
+	unsigned long     items;
+	const GBYTE*      b;
+	gif_t*            agif;
+	image_t*          i;
+	image_t*          p;
+	image_t*          current;
+	GBYTE             c;
+	GBOOL             done;
+	GBOOL             gceread;
+	GBOOL             screen;
+	GBOOL             ok;
+	UNSIGNED          sw, sh;
+#ifdef GIF_STATS
+	unsigned long long t;
+#endif
+
+	// Push contexts have nothing to read from.
+
+	if (ctx->read == NULL && ctx->span == NULL) {
+		ctx->error = ERRORFAILED;
+		return GFALSE;
+	}
+
+	STAT (memset (&ctx->stats, 0, sizeof (stats_t)));
+	STAT (GIF_StartStats (ctx));
+
+	ctx->error         = ERRORNONE;
+	ctx->damage        = ERRORNONE;
+	ctx->decoder.error = ERRORNONE;
+	ctx->decoded       = 0;
+	ctx->extensions    = 0;
+	ctx->spent         = 0;
+
+	// Every call parses from the start of the stream, wherever the last one
+	// left the context. A stream without a move function cannot go back:
+	// it is not truncated but used up.
+
+	if (ctx->position > 0 && ctx->span == NULL && ctx->move == NULL) {
+		ctx->error = ERRORFAILED;
+		return GFALSE;
+	}
+
+	if (ctx->position > 0 && !GIF_Seek (ctx, 0)) {
+		return GFALSE;
+	}
+
+	GIF_StartDeadline (ctx);
+
+	current = NULL;
+	screen  = GFALSE;
+
+	if ((agif = GIF_NewGif (&ctx->allocator)) == NULL) {
+		ctx->error = ERRORMEMORY;
+		return GFALSE;
+	}
+
+	if ((b = GIF_Fetch (ctx, HEADERSIZE + LSDSIZE)) == NULL) {
+		goto clean;
+	}
+
+	if (!GIF_ParseScreen (ctx, agif, b, &items)) {
+		goto clean;
+	}
+
+	if (!GIF_CheckScreen (ctx, agif)) {
+		goto clean;
+	}
+
+	screen = GTRUE;
+
+	// A scaled GIF looks like one made at the smaller size.
+
+	sw = agif->screenwidth;
+	sh = agif->screenheight;
+
+	if (ctx->scalewidth > 0) {
+		agif->screenwidth  = ctx->scalewidth;
+		agif->screenheight = ctx->scaleheight;
+	}
+
+	if (items > 0) {
+		if ((agif->palette = GIF_ReadPalette (ctx, agif, items)) == NULL) {
+			goto clean;
+		}
+
+		agif->gct = agif->palette->colors;
+	}
+
+	if (ctx->start > 0 && !GIF_Seek (ctx, ctx->start)) {
+		goto clean;
+	}
+
+	done    = GFALSE;
+	gceread = GFALSE;
+	p       = NULL;
+
+	while (!done) {
+		current = NULL;
+
+		// Streams of many small blocks are held to the time limit too.
+
+		if (ctx->decoder.deadline > 0 && T_Time () > ctx->decoder.deadline) {
+			ctx->error = ERRORLIMITTIME;
+			goto clean;
+		}
+
+		if (!GIF_Read (ctx, &c, sizeof (GBYTE))) {
+			goto clean;
+		}
+
+		switch (c) {
+
+			// Extension block.
+
+			case EXTENSIONBLOCK:
+				if (!GIF_Read (ctx, &c, sizeof (GBYTE))) {
+					goto clean;
+				}
+
+				switch (c) {
+
+					// Plain text label.
+
+					case PLAINTEXTLABEL:
+						if (!GIF_ReadPlainTextBlock (ctx, agif, &gceread, &gce)) {
+							goto clean;
+						}
+
+						break;
+
+					// Graphic control label.
+
+					case GRAPHICCONTROLLABEL:
+						if (!GIF_ReadGraphicControlBlock (ctx, &gceread, &gce)) {
+							goto clean;
+						}
+
+						break;
+
+					// Comment label.
+
+					case COMMENTLABEL:
+						if (!GIF_ReadCommentBlock (ctx, agif)) {
+							goto clean;
+						}
+
+						break;
+
+					// Application extension label.
+
+					case APPLICATIONEXTENSIONLABEL:
+						if (!GIF_ReadApplicationBlock (ctx, agif)) {
+							goto clean;
+						}
+
+						if (agif->apps) {
+							GIF_ReadLoopCount (agif, agif->apps);
+						}
+
+						break;
+
+					// Unknown extensions are skipped whole.
+
+					default:
+						if (!GIF_SkipSubBlocks (ctx)) {
+							goto clean;
+						}
+
+						break;
+				};
+
+				break;
+
+			// Image separator.
+
+			case IMAGESEPARATOR:
+				if ((b = GIF_Fetch (ctx, IMAGEDESCRIPTORSIZE)) == NULL) {
+					goto clean;
+				}
+
+				if ((i = GIF_NewImage (agif, &p, b, &gceread, &gce, &items)) == NULL) {
+					ctx->error = ERRORMEMORY;
+					goto clean;
+				}
+
+				current = i;
+
+				if (!GIF_CheckImage (ctx, agif, i, mode != SKIPIMAGES)) {
+					goto clean;
+				}
+
+				i->descoffset = ctx->position - IMAGEDESCRIPTORSIZE - 1;
+
+				// Images with the same colors share one palette.
+
+				if (items > 0) {
+					if ((i->palette = GIF_ReadPalette (ctx, agif, items)) == NULL) {
+						goto clean;
+					}
+
+					i->lct = i->palette->colors;
+				}
+
+				i->dataoffset = ctx->position;
+
+				// Streamed images borrow the frame buffer of the context for
+				// as long as the frame function runs, and are then dropped.
+
+				if (mode == STREAMIMAGES) {
+					if (!B_ReserveBuffer (ctx->framebuffer, (unsigned long) i->width * i->height)) {
+						ctx->error = ERRORMEMORY;
+						goto clean;
+					}
+
+					ctx->framebuffer->size  = 0;
+					ctx->framebuffer->index = 0;
+
+					i->indexes = ctx->framebuffer;
+
+					STAT (t = T_Time ());
+					ok = GIF_DecompressStreamed (ctx, agif, i) || GIF_Tolerate (ctx, i);
+					STAT (GIF_TimeImage (ctx, i, t));
+
+					// A damaged image is handed over all the same.
+
+					if ((ok || i->damaged) && ctx->frame && !ctx->frame (ctx->streamuser, agif, i)) {
+						ok = GIF_Fail (ctx, ERRORSTOPPED);
+					}
+
+					i->indexes = NULL;
+
+					if (!ok) {
+						goto clean;
+					}
+
+					GIF_FreeImages (agif, i);
+
+					agif->images = NULL;
+					p            = NULL;
+
+					break;
+				}
+
+				if (mode == DECODEIMAGES && ctx->scalewidth > 0) {
+					STAT (t = T_Time ());
+
+					if (!GIF_DecompressScaled (ctx, agif, i, sw, sh) && !GIF_Tolerate (ctx, i)) {
+						goto clean;
+					}
+
+					STAT (GIF_TimeImage (ctx, i, t));
+
+					break;
+				}
+
+				// This will be filled after decompression.
+
+				if (mode != SKIPIMAGES) {
+					if ((i->indexes = B_AllocBuffer (&agif->allocator, (unsigned long) i->width * i->height)) == NULL) {
+						ctx->error = ERRORMEMORY;
+						goto clean;
+					}
+				}
+
+				// Decompress RGB information, or only note where it is when
+				// images are decoded after parsing or not decoded at all.
+
+				if (mode != DECODEIMAGES) {
+					if (!GIF_SkipData (ctx)) {
+						goto clean;
+					}
+				} else {
+					STAT (t = T_Time ());
+
+					if (!GIF_DecompressData (ctx, i) && !GIF_Tolerate (ctx, i)) {
+						goto clean;
+					}
+
+					STAT (GIF_TimeImage (ctx, i, t));
+				}
+
+				break;
+
+			// Trailer.
+
+			case TRAILER:
+				done = GTRUE;
+
+				break;
+
+			// Any other code is an error.
+
+			default:
+				ctx->error = ERRORBADBLOCK;
+				goto clean;
+		}
+
+		if (ctx->limit > 0 && agif->imagecount >= ctx->limit) {
+			done = GTRUE;
+		}
+	}
+
+	if (mode == DEFERIMAGES) {
+		if (!GIF_DecodeImages (ctx, agif)) {
+			goto clean;
+		}
+	}
+
+	STAT (GIF_EndStats (ctx));
+
+	*gif = agif;
+
+	return GTRUE;
+
+clean:
+	GIF_SetFailed (ctx);
+
+	// In tolerant mode, what was parsed before a recoverable error is kept
+	// once the screen is known. An image whose data was not reached is
+	// dropped, as is a streamed one, already handed over.
+
+	if (ctx->tolerant && GIF_Recoverable (ctx->error) && screen) {
+		if (current && (mode == STREAMIMAGES || current->dataoffset == 0)) {
+			GIF_DropImage (agif, current);
+		} else if (current && mode != DEFERIMAGES) {
+			GIF_DamageImage (current);
+		}
+
+		if (ctx->damage == ERRORNONE) {
+			ctx->damage = ctx->error;
+		}
+
+		ctx->error = ERRORNONE;
+
+		if (mode != DEFERIMAGES || GIF_DecodeImages (ctx, agif)) {
+			STAT (GIF_EndStats (ctx));
+
+			*gif = agif;
+
+			return GTRUE;
+		}
+
+		GIF_SetFailed (ctx);
+	}
+
+	STAT (GIF_EndStats (ctx));
+
+	GIF_FreeGif (agif);
+
+	return GFALSE;
+}
+
+/*
+  Creates a context for the push parser: data is handed to GIF_Push() in
+  chunks of any size as it arrives. "f", if not NULL, is called with "user"
+  each time a chunk advances the image being decoded, and once more when the
+  image is complete.
+*/
+
+context_t* GIF_NewPushContext (IS f, void* user) {
+	context_t* ctx;
+
+	if ((ctx = GIF_AllocContext ()) == NULL) {
+		return NULL;
+	}
+
+	if ((ctx->data = B_NewBuffer (NULL, MAXBLOCKSIZE)) == NULL) {
+		free (ctx);
+		return NULL;
+	}
+
+	ctx->callback = f;
+	ctx->user     = user;
+	ctx->state    = PUSHSCREEN;
+	ctx->need     = HEADERSIZE + LSDSIZE;
+	ctx->held     = 0;
+	ctx->last     = NULL;
+	ctx->current  = NULL;
+	ctx->gceread  = GFALSE;
+
+	return ctx;
+}
+
+void GIF_PushState (context_t* ctx, GBYTE state, unsigned long need) {
+	ctx->state = state;
+	ctx->need  = need;
+}
+
+/*
+  Starts reading data sub-blocks belonging to "target".
+*/
+
+void GIF_PushSubBlocks (context_t* ctx, GBYTE target) {
+	ctx->target      = target;
+	ctx->data->size  = 0;
+	ctx->data->index = 0;
+
+	GIF_PushState (ctx, PUSHSIZE, 1);
+}
+
+GBOOL GIF_PushProgress (context_t* ctx, GBOOL complete) {
+	ctx->reported = ctx->last->indexes->size;
+
+	if (ctx->callback) {
+		return ctx->callback (ctx->user, ctx->gif, ctx->last, complete);
+	}
+
+	return GTRUE;
+}
+
+/*
+  Called once the image being pushed hit a bad code. In tolerant mode the rest
+  of its data is skipped, and it is damaged once the data ends.
+*/
+
+GBOOL GIF_PushTolerate (context_t* ctx) {
+	if (!ctx->tolerant || ctx->decoder.error != ERRORBADCODE) {
+		return GFALSE;
+	}
+
+	if (ctx->damage == ERRORNONE) {
+		ctx->damage = ERRORBADCODE;
+	}
+
+	ctx->decoder.error = ERRORNONE;
+	ctx->decoder.done  = GTRUE;
+	ctx->last->damaged = GTRUE;
+
+	return GTRUE;
+}
+
+/*
+  Handles "count" bytes of a data sub-block as they arrive.
+*/
+
+GBOOL GIF_PushSubBlock (context_t* ctx, const GBYTE* data, unsigned long count) {
+	decoder_t* d;
+	GBOOL      ok;
+#ifdef GIF_STATS
+	unsigned long long t;
+#endif
+
+	switch (ctx->target) {
+		case SUBBLOCKCOMMENT:
+		case SUBBLOCKAPP:
+		case SUBBLOCKTEXT:
+			if (ctx->data->size + count > GIF_ExtensionRoom (ctx)) {
+				ctx->error = ERRORLIMITEXTENSION;
+				return GFALSE;
+			}
+
+			if (!B_ReserveBuffer (ctx->data, ctx->data->size + count)) {
+				return GIF_Fail (ctx, ERRORMEMORY);
+			}
+
+			memcpy ((GBYTE*) ctx->data->data + ctx->data->size, data, count);
+			ctx->data->size += count;
+
+			return GTRUE;
+
+		case SUBBLOCKIMAGE:
+			d = &ctx->decoder;
+
+			if (d->done) {
+				return GTRUE;
+			}
+
+			GIF_FeedReader (&d->reader, data, count);
+
+			STAT (t = T_Time ());
+			ok = GIF_DecodeTimed (d, ctx->last->indexes);
+			STAT (GIF_TimeImage (ctx, ctx->last, t));
+
+			return ok || GIF_PushTolerate (ctx);
+
+		default:
+			return GTRUE;
+	}
+}
+
+/*
+  Handles the block terminator of the data sub-blocks being read.
+*/
+
+GBOOL GIF_PushEndOfSubBlocks (context_t* ctx) {
+	switch (ctx->target) {
+		case SUBBLOCKCOMMENT:
+			ctx->extensions += ctx->data->size;
+
+			if (ctx->data->size > 0) {
+				return GIF_NewComment (ctx->gif, (GBYTE*) ctx->data->data, ctx->data->size) || GIF_Fail (ctx, ERRORMEMORY);
+			}
+
+			return GTRUE;
+
+		case SUBBLOCKAPP:
+			ctx->extensions += ctx->data->size;
+
+			if (ctx->data->size > 0) {
+				if (!GIF_NewApp (ctx->gif, &ctx->appext, (GBYTE*) ctx->data->data, ctx->data->size)) {
+					return GIF_Fail (ctx, ERRORMEMORY);
+				}
+
+				GIF_ReadLoopCount (ctx->gif, ctx->gif->apps);
+			}
+
+			return GTRUE;
+
+		case SUBBLOCKTEXT:
+			ctx->extensions += ctx->data->size;
+
+			return GIF_NewText (ctx->gif, &ctx->text, &ctx->gceread, &ctx->gce, (GBYTE*) ctx->data->data, ctx->data->size) || GIF_Fail (ctx, ERRORMEMORY);
+
+		case SUBBLOCKIMAGE:
+			if (ctx->last->damaged) {
+				GIF_DamageImage (ctx->last);
+			} else {
+				GIF_FillUndecoded (ctx->last, 0);
+			}
+
+			ctx->current = NULL;
+
+			return GIF_PushProgress (ctx, GTRUE) || GIF_Fail (ctx, ERRORSTOPPED);
+
+		default:
+			return GTRUE;
+	}
+}
+
+/*
+  Handles "ctx->need" bytes at "b", all belonging to the current state.
+*/
+
+GBOOL GIF_PushBlock (context_t* ctx, const GBYTE* b) {
+	unsigned long items;
+	image_t*      i;
+
+	switch (ctx->state) {
+		case PUSHSCREEN:
+
+			// The GIF is made here, so an allocator set after creating the
+			// context is used.
+
+			if ((ctx->gif = GIF_NewGif (&ctx->allocator)) == NULL) {
+				return GIF_Fail (ctx, ERRORMEMORY);
+			}
+
+			if (!GIF_ParseScreen (ctx, ctx->gif, b, &items)) {
+				return GFALSE;
+			}
+
+			if (!GIF_CheckScreen (ctx, ctx->gif)) {
+				return GFALSE;
+			}
+
+			if (items > 0) {
+				GIF_PushState (ctx, PUSHGCT, sizeof (rgb_t) * items);
+			} else {
+				GIF_PushState (ctx, PUSHBLOCK, 1);
+			}
+
+			return GTRUE;
+
+		case PUSHGCT:
+			if ((ctx->gif->palette = GIF_InternPalette (ctx->gif, b, ctx->need / sizeof (rgb_t))) == NULL) {
+				return GIF_Fail (ctx, ERRORMEMORY);
+			}
+
+			ctx->gif->gct = ctx->gif->palette->colors;
+			GIF_PushState (ctx, PUSHBLOCK, 1);
+
+			return GTRUE;
+
+		case PUSHBLOCK:
+			switch (b[0]) {
+				case EXTENSIONBLOCK:
+					GIF_PushState (ctx, PUSHLABEL, 1);
+					return GTRUE;
+
+				case IMAGESEPARATOR:
+					GIF_PushState (ctx, PUSHDESCRIPTOR, IMAGEDESCRIPTORSIZE);
+					return GTRUE;
+
+				case TRAILER:
+					GIF_PushState (ctx, PUSHDONE, 0);
+					return GTRUE;
+
+				default:
+					return GIF_Fail (ctx, ERRORBADBLOCK);
+			}
+
+		case PUSHLABEL:
+			switch (b[0]) {
+				case PLAINTEXTLABEL:
+					GIF_PushState (ctx, PUSHTEXT, TEXTSIZE);
+					return GTRUE;
+
+				case GRAPHICCONTROLLABEL:
+					GIF_PushState (ctx, PUSHGCE, GCESIZE);
+					return GTRUE;
+
+				case COMMENTLABEL:
+					GIF_PushSubBlocks (ctx, SUBBLOCKCOMMENT);
+					return GTRUE;
+
+				case APPLICATIONEXTENSIONLABEL:
+					GIF_PushState (ctx, PUSHAPPEXT, APPEXTSIZE);
+					return GTRUE;
+
+				// Unknown extensions are skipped whole.
+
+				default:
+					GIF_PushSubBlocks (ctx, SUBBLOCKSKIP);
+					return GTRUE;
+			}
+
+		case PUSHGCE:
+
+			// Only one graphic control block per graphic rendering block.
+
+			if (ctx->gceread) {
+				return GIF_Fail (ctx, ERRORBADBLOCK);
+			}
+
+			if (!GIF_ParseGraphicControl (ctx, &ctx->gceread, &ctx->gce, b)) {
+				return GFALSE;
+			}
+
+			ctx->gce.offset = ctx->position - GCESIZE - 2;
+
+			GIF_PushState (ctx, PUSHBLOCK, 1);
+
+			return GTRUE;
+
+		case PUSHAPPEXT:
+
+			// Block size must to be 11.
+
+			if (b[0] != APPLICATIONIDSIZE + APPLICATIONAUTHCODESIZE) {
+				return GIF_Fail (ctx, ERRORBADBLOCK);
+			}
+
+			ctx->appext.blocksize = b[0];
+			memcpy (ctx->appext.appid, b + 1, APPLICATIONIDSIZE);
+			memcpy (ctx->appext.authcode, b + 1 + APPLICATIONIDSIZE, APPLICATIONAUTHCODESIZE);
+			GIF_PushSubBlocks (ctx, SUBBLOCKAPP);
+
+			return GTRUE;
+
+		case PUSHTEXT:
+			if (!GIF_ParsePlainText (ctx, &ctx->text, b)) {
+				return GFALSE;
+			}
+
+			GIF_PushSubBlocks (ctx, SUBBLOCKTEXT);
+
+			return GTRUE;
+
+		case PUSHSIZE:
+			if (b[0] == 0) {
+				if (!GIF_PushEndOfSubBlocks (ctx)) {
+					return GFALSE;
+				}
+
+				GIF_PushState (ctx, PUSHBLOCK, 1);
+
+				return GTRUE;
+			}
+
+			GIF_PushState (ctx, PUSHSUBBLOCK, b[0]);
+
+			return GTRUE;
+
+		case PUSHDESCRIPTOR:
+			if ((i = GIF_NewImage (ctx->gif, &ctx->last, b, &ctx->gceread, &ctx->gce, &items)) == NULL) {
+				return GIF_Fail (ctx, ERRORMEMORY);
+			}
+
+			if (!GIF_CheckImage (ctx, ctx->gif, i, GTRUE)) {
+				return GFALSE;
+			}
+
+			if ((i->indexes = B_AllocBuffer (&ctx->gif->allocator, (unsigned long) i->width * i->height)) == NULL) {
+				return GIF_Fail (ctx, ERRORMEMORY);
+			}
+
+			i->descoffset = ctx->position - IMAGEDESCRIPTORSIZE - 1;
+			ctx->reported = 0;
+			ctx->current  = i;
+
+			// The data offset is known once past the local color table.
+
+			if (items > 0) {
+				GIF_PushState (ctx, PUSHLCT, sizeof (rgb_t) * items);
+			} else {
+				i->dataoffset = ctx->position;
+				GIF_PushState (ctx, PUSHCODESIZE, 1);
+			}
+
+			return GTRUE;
+
+		case PUSHLCT:
+			if ((ctx->last->palette = GIF_InternPalette (ctx->gif, b, ctx->need / sizeof (rgb_t))) == NULL) {
+				return GIF_Fail (ctx, ERRORMEMORY);
+			}
+
+			ctx->last->lct = ctx->last->palette->colors;
+			ctx->last->dataoffset = ctx->position;
+			GIF_PushState (ctx, PUSHCODESIZE, 1);
+
+			return GTRUE;
+
+		case PUSHCODESIZE:
+			if (!GIF_StartDecoder (&ctx->decoder, b[0], ctx->last) && !GIF_PushTolerate (ctx)) {
+				return GFALSE;
+			}
+
+			GIF_InitReader (&ctx->decoder.reader, b, 0);
+			GIF_PushSubBlocks (ctx, SUBBLOCKIMAGE);
+
+			return GTRUE;
+
+		default:
+			return GFALSE;
+	}
+}
+
+/*
+  Pushes the next "size" bytes of the stream. Images are reported to the
+  context function while they are decoded. Returns GFALSE if the data is not a
+  valid GIF stream; the context then refuses any further data.
+*/
+
+GBOOL GIF_Push (context_t* ctx, const GBYTE* data, unsigned long size) {
+	const GBYTE*       b;
+	unsigned long      n;
+	unsigned long long start;
+
+	// Only push contexts take data, until they fail or their GIF is handed
+	// over. The GIF itself is made once the screen arrives.
+
+	if (ctx->read || ctx->span || ctx->state == PUSHFAILED) {
+		return GFALSE;
+	}
+
+	if (ctx->gif == NULL && ctx->state != PUSHSCREEN) {
+		return GFALSE;
+	}
+
+	// Statistics add up over all the pushes.
+
+	STAT (GIF_StartStats (ctx));
+	STAT (ctx->stats.bytesread += size);
+	STAT (ctx->stats.reads++);
+
+	// The time limit holds for all the pushes together.
+
+	GIF_StartDeadline (ctx);
+
+	start = ctx->decoder.deadline > 0 ? T_Time () : 0;
+
+	while (size > 0 && ctx->state != PUSHDONE) {
+		if (ctx->decoder.deadline > 0 && T_Time () > ctx->decoder.deadline) {
+			ctx->error = ERRORLIMITTIME;
+			goto clean;
+		}
+
+		// Sub-block data is used as it comes, without gathering it.
+
+		if (ctx->state == PUSHSUBBLOCK) {
+			n = ctx->need < size ? ctx->need : size;
+
+			if (!GIF_PushSubBlock (ctx, data, n)) {
+				goto clean;
+			}
+
+			data          += n;
+			size          -= n;
+			ctx->need     -= n;
+			ctx->position += n;
+
+			if (ctx->need == 0) {
+				GIF_PushState (ctx, PUSHSIZE, 1);
+			}
+
+			continue;
+		}
+
+		// Anything else is handled once all its bytes are there: in place if
+		// the chunk holds all of them, from "hold" otherwise.
+
+		if (ctx->held == 0 && size >= ctx->need) {
+			b     = data;
+			data += ctx->need;
+			size -= ctx->need;
+		} else {
+			n = ctx->need - ctx->held < size ? ctx->need - ctx->held : size;
+
+			memcpy (ctx->hold + ctx->held, data, n);
+
+			ctx->held += n;
+			data      += n;
+			size      -= n;
+
+			if (ctx->held < ctx->need) {
+				break;
+			}
+
+			b         = ctx->hold;
+			ctx->held = 0;
+		}
+
+		ctx->position += ctx->need;
+
+		if (!GIF_PushBlock (ctx, b)) {
+			goto clean;
+		}
+	}
+
+	// Report what this chunk added to an image still being decoded.
+
+	if (ctx->state == PUSHSUBBLOCK || ctx->state == PUSHSIZE) {
+		if (ctx->target == SUBBLOCKIMAGE && ctx->last->indexes->size > ctx->reported) {
+			if (!GIF_PushProgress (ctx, GFALSE)) {
+				ctx->error = ERRORSTOPPED;
+				goto clean;
+			}
+		}
+	}
+
+	STAT (GIF_EndStats (ctx));
+
+	if (start > 0) {
+		ctx->spent += T_Time () - start;
+	}
+
+	return GTRUE;
+
+clean:
+	STAT (GIF_EndStats (ctx));
+
+	GIF_SetFailed (ctx);
+	ctx->state = PUSHFAILED;
+
+	return GFALSE;
+}
+
+/*
+  Ends pushing data. If the whole stream was pushed, the decoded GIF is handed
+  over in "gif"; otherwise GFALSE is returned and everything decoded so far is
+  released along with the context. In tolerant mode, a stream that ended early
+  or failed at a recoverable error hands over what was decoded, the image it
+  stopped in marked damaged.
+*/
+
+GBOOL GIF_EndPush (context_t* ctx, gif_t** gif) {
+	if (ctx->state != PUSHDONE && ctx->state != PUSHFAILED) {
+		GIF_Fail (ctx, ERRORTRUNCATED);
+		ctx->state = PUSHFAILED;
+	}
+
+	if (ctx->gif && ctx->state == PUSHFAILED && ctx->tolerant && GIF_Recoverable (ctx->error)) {
+		if (ctx->current && ctx->current->dataoffset == 0) {
+			GIF_DropImage (ctx->gif, ctx->current);
+		} else if (ctx->current) {
+			GIF_DamageImage (ctx->current);
+		}
+
+		if (ctx->damage == ERRORNONE) {
+			ctx->damage = ctx->error;
+		}
+
+		ctx->error   = ERRORNONE;
+		ctx->current = NULL;
+		ctx->state   = PUSHDONE;
+	}
+
+	if (ctx->gif == NULL || ctx->state != PUSHDONE) {
+		return GFALSE;
+	}
+
+	*gif     = ctx->gif;
+	ctx->gif = NULL;
+
+	return GTRUE;
+}
+
+GBOOL GIF_Decode (context_t* ctx, gif_t** gif) {
+	return GIF_Parse (ctx, gif, (ctx->threads > 1 && ctx->span && ctx->scalewidth == 0) ? DEFERIMAGES : DECODEIMAGES);
+}
+
+/*
+  Reads the structure of the stream without decoding image data: image data
+  sub-blocks are skipped by their sizes and images are left without buffers.
+*/
+
+GBOOL GIF_Scan (context_t* ctx, gif_t** gif) {
+	return GIF_Parse (ctx, gif, SKIPIMAGES);
+}
+
+/*
+  Decodes "count" images starting with the block at "offset", which must be
+  the first block of an image: its graphic control extension, or its image
+  descriptor when it has none. The screen and the global color table are read
+  from the start of the stream first, so the context must be able to move
+  back unless it is already there. A "count" of 0 decodes up to the trailer.
+  "gif" holds only the images decoded.
+*/
+
+GBOOL GIF_DecodeRange (context_t* ctx, gif_t** gif, unsigned long offset, unsigned long count) {
+	GBOOL result;
+
+	ctx->start = offset;
+	ctx->limit = count;
+
+	result = GIF_Parse (ctx, gif, DECODEIMAGES);
+
+	ctx->start = 0;
+	ctx->limit = 0;
+
+	return result;
+}
+
+/*
+  Decodes the stream one image at a time into a single frame buffer, so
+  memory stays that of the largest image whatever the number of images.
+  "row", if not NULL, is called with each row as soon as it is decoded, and
+  "frame", if not NULL, with each image once complete; both get "user". The
+  image and its indexes are only valid during the call: afterwards the image
+  is dropped, so "gif" ends with the global data of the stream and no images,
+  "imagecount" telling how many were decoded.
+*/
+
+GBOOL GIF_Stream (context_t* ctx, gif_t** gif, FS frame, RS row, void* user) {
+	GBOOL result;
+
+	if (ctx->framebuffer == NULL) {
+		if ((ctx->framebuffer = B_AllocBuffer (NULL, MAXBLOCKSIZE)) == NULL) {
+			ctx->error = ERRORMEMORY;
+			return GFALSE;
+		}
+	}
+
+	ctx->frame      = frame;
+	ctx->row        = row;
+	ctx->streamuser = user;
+
+	result = GIF_Parse (ctx, gif, STREAMIMAGES);
+
+	ctx->frame      = NULL;
+	ctx->row        = NULL;
+	ctx->streamuser = NULL;
+
+	return result;
+}
+
+GBOOL GIF_ProcessContext (gif_t** gif, context_t* ctx, GBOOL scan) {
+	GBOOL result;
+
+	if (ctx == NULL) {
+		return GFALSE;
+	}
+
+	if (scan) {
+		result = GIF_Scan (ctx, gif);
+	} else {
+		result = GIF_Decode (ctx, gif);
+	}
+
+	GIF_FreeContext (ctx);
+
+	return result;
+}
+
+GBOOL GIF_ProcessStream (gif_t** gif, MS r, MSP mp, void* user) {
+	return GIF_ProcessContext (gif, GIF_NewContext (r, mp, user), GFALSE);
+}
+
+GBOOL GIF_ProcessMemory (gif_t** gif, const GBYTE* data, unsigned long size) {
+	return GIF_ProcessContext (gif, GIF_NewMemoryContext (data, size), GFALSE);
+}
+
+GBOOL GIF_ProcessFile (gif_t** gif, const char* path) {
+	return GIF_ProcessContext (gif, GIF_NewFileContext (path), GFALSE);
+}
+
+GBOOL GIF_ScanStream (gif_t** gif, MS r, MSP mp, void* user) {
+	return GIF_ProcessContext (gif, GIF_NewContext (r, mp, user), GTRUE);
+}
+
+GBOOL GIF_ScanMemory (gif_t** gif, const GBYTE* data, unsigned long size) {
+	return GIF_ProcessContext (gif, GIF_NewMemoryContext (data, size), GTRUE);
+}
+
+GBOOL GIF_ScanFile (gif_t** gif, const char* path) {
+	return GIF_ProcessContext (gif, GIF_NewFileContext (path), GTRUE);
+}
@@ -0,0 +1,351 @@
+#include <stdlib.h>
+#include <string.h>
+#include "index.h"
+#include "format.h"
+
+// Saved index: magic, version and number of frames, then for each frame its
+// flags and offsets as variable-length numbers, seven bits per byte. Offsets
+// are stored as distances from the previous one, which keeps most of them to
+// one or two bytes.
+
+#define INDEXMAGIC                     "GIFX"
+#define INDEXMAGICSIZE                 4
+#define INDEXVERSION                   1
+#define FRAMEKEY                       0x01
+#define FRAMEGCE                       0x02
+#define FRAMELCT                       0x04
+
+frameindex_t* FI_AllocIndex (unsigned long count) {
+	frameindex_t* index;
+
+	if ((index = (frameindex_t*) malloc (sizeof (frameindex_t))) == NULL) {
+		return NULL;
+	}
+
+	index->count = count;
+
+	if ((index->frames = (frameentry_t*) calloc (count + 1, sizeof (frameentry_t))) == NULL) {
+		free (index);
+		return NULL;
+	}
+
+	return index;
+}
+
+GBOOL FI_FullScreen (gif_t* gif, image_t* image) {
+	return image->left == 0 && image->top == 0 && image->width >= gif->screenwidth && image->height >= gif->screenheight;
+}
+
+/*
+  Builds the index of the images of "gif", scanned or decoded from a stream,
+  which must be complete: keyframes are found by following disposals from the
+  first image on.
+*/
+
+frameindex_t* FI_NewIndex (gif_t* gif) {
+	frameindex_t* index;
+	frameentry_t* f;
+	image_t*      i;
+	image_t*      p;
+
+	if ((index = FI_AllocIndex (gif->imagecount)) == NULL) {
+		return NULL;
+	}
+
+	for (i = gif->images, p = NULL, f = index->frames; i && f < index->frames + index->count; p = i, i = i->next, f++) {
+		f->gceoffset  = i->gceoffset;
+		f->descoffset = i->descoffset;
+		f->lctoffset  = i->lct ? i->descoffset + 1 + IMAGEDESCRIPTORSIZE : 0;
+		f->dataoffset = i->dataoffset;
+		f->offset     = i->gceoffset ? i->gceoffset : i->descoffset;
+
+		// The first image is drawn onto a cleared canvas. Later ones are if
+		// the image before them was cleared and covered either the whole
+		// screen or only a cleared canvas. An opaque image covering the whole
+		// screen needs nothing before it either, unless it is disposed of by
+		// restoring what it covered.
+
+		if (p == NULL) {
+			f->keyframe = GTRUE;
+		} else if (FI_FullScreen (gif, i) && !i->transparent && i->disposal != DISPOSALPREVIOUS) {
+			f->keyframe = GTRUE;
+		} else {
+			f->keyframe = (p->disposal == DISPOSALBACKGROUND && (FI_FullScreen (gif, p) || f[-1].keyframe)) ? GTRUE : GFALSE;
+		}
+	}
+
+	// Fewer images than counted: the GIF was not built by a parser.
+
+	if (f < index->frames + index->count) {
+		FI_FreeIndex (index);
+		return NULL;
+	}
+
+	return index;
+}
+
+/*
+  Scans the stream of "ctx" from where it is and indexes its frames.
+*/
+
+frameindex_t* FI_BuildIndex (context_t* ctx) {
+	frameindex_t* index;
+	gif_t*        gif;
+
+	if (!GIF_Scan (ctx, &gif)) {
+		return NULL;
+	}
+
+	index = FI_NewIndex (gif);
+	GIF_FreeGif (gif);
+
+	return index;
+}
+
+void FI_FreeIndex (frameindex_t* index) {
+	if (index) {
+		free (index->frames);
+		free (index);
+	}
+}
+
+GBOOL FI_PutNumber (buffer_t* blob, unsigned long n) {
+	GBYTE b;
+
+	do {
+		b = (GBYTE) (n & 0x7F);
+		n >>= 7;
+
+		if (n) {
+			b |= 0x80;
+		}
+
+		if (!B_ReserveBuffer (blob, blob->size + 1)) {
+			return GFALSE;
+		}
+
+		((GBYTE*) blob->data)[blob->size++] = b;
+	} while (n);
+
+	return GTRUE;
+}
+
+GBOOL FI_GetNumber (const GBYTE** p, const GBYTE* end, unsigned long* n) {
+	unsigned int shift;
+
+	*n = 0;
+
+	for (shift = 0; *p < end && shift < sizeof (unsigned long) * 8; shift += 7) {
+		*n |= (unsigned long) (**p & 0x7F) << shift;
+
+		if ((*(*p)++ & 0x80) == 0) {
+			return GTRUE;
+		}
+	}
+
+	return GFALSE;
+}
+
+/*
+  Saves "index" to a new buffer, of which "size" bytes are the blob.
+*/
+
+buffer_t* FI_SaveIndex (frameindex_t* index) {
+	buffer_t*     blob;
+	frameentry_t* f;
+	unsigned long k, last;
+	GBYTE         flags;
+
+	if ((blob = B_AllocBuffer (NULL, MAXBLOCKSIZE)) == NULL) {
+		return NULL;
+	}
+
+	memcpy (blob->data, INDEXMAGIC, INDEXMAGICSIZE);
+	((GBYTE*) blob->data)[INDEXMAGICSIZE] = INDEXVERSION;
+	blob->size = INDEXMAGICSIZE + 1;
+
+	if (!FI_PutNumber (blob, index->count)) {
+		goto clean;
+	}
+
+	// Each frame follows the data of the one before it.
+
+	for (k = 0, last = 0; k < index->count; k++) {
+		f     = index->frames + k;
+		flags = (f->keyframe ? FRAMEKEY : 0) | (f->gceoffset ? FRAMEGCE : 0) | (f->lctoffset ? FRAMELCT : 0);
+
+		if (f->descoffset < last || f->dataoffset < f->descoffset || f->gceoffset > f->descoffset) {
+			goto clean;
+		}
+
+		if (!B_ReserveBuffer (blob, blob->size + 1)) {
+			goto clean;
+		}
+
+		((GBYTE*) blob->data)[blob->size++] = flags;
+
+		if (!FI_PutNumber (blob, f->descoffset - last)) {
+			goto clean;
+		}
+
+		if (f->gceoffset && !FI_PutNumber (blob, f->descoffset - f->gceoffset)) {
+			goto clean;
+		}
+
+		if (!FI_PutNumber (blob, f->dataoffset - f->descoffset)) {
+			goto clean;
+		}
+
+		last = f->dataoffset;
+	}
+
+	return blob;
+
+clean:
+	B_FreeBuffer (blob);
+
+	return NULL;
+}
+
+/*
+  Loads an index saved by FI_SaveIndex. Returns NULL if "data" is not one.
+*/
+
+frameindex_t* FI_LoadIndex (const GBYTE* data, unsigned long size) {
+	frameindex_t* index;
+	frameentry_t* f;
+	const GBYTE*  p;
+	const GBYTE*  end;
+	unsigned long count, k, n, last;
+	GBYTE         flags;
+
+	if (size < INDEXMAGICSIZE + 1 || memcmp (data, INDEXMAGIC, INDEXMAGICSIZE) || data[INDEXMAGICSIZE] != INDEXVERSION) {
+		return NULL;
+	}
+
+	p   = data + INDEXMAGICSIZE + 1;
+	end = data + size;
+
+	// Every frame takes three bytes at least.
+
+	if (!FI_GetNumber (&p, end, &count) || count > (unsigned long) (end - p) / 3) {
+		return NULL;
+	}
+
+	if ((index = FI_AllocIndex (count)) == NULL) {
+		return NULL;
+	}
+
+	for (k = 0, last = 0; k < count; k++) {
+		f = index->frames + k;
+
+		if (p >= end || (*p & ~(FRAMEKEY | FRAMEGCE | FRAMELCT))) {
+			goto clean;
+		}
+
+		flags       = *p++;
+		f->keyframe = (flags & FRAMEKEY) ? GTRUE : GFALSE;
+
+		if (!FI_GetNumber (&p, end, &n) || n > (unsigned long) -1 - last) {
+			goto clean;
+		}
+
+		f->descoffset = last + n;
+
+		if (flags & FRAMEGCE) {
+			if (!FI_GetNumber (&p, end, &n) || n == 0 || n > f->descoffset) {
+				goto clean;
+			}
+
+			f->gceoffset = f->descoffset - n;
+		}
+
+		if (!FI_GetNumber (&p, end, &n) || n < 1 + IMAGEDESCRIPTORSIZE || n > (unsigned long) -1 - f->descoffset) {
+			goto clean;
+		}
+
+		f->dataoffset = f->descoffset + n;
+		f->lctoffset  = (flags & FRAMELCT) ? f->descoffset + 1 + IMAGEDESCRIPTORSIZE : 0;
+		f->offset     = f->gceoffset ? f->gceoffset : f->descoffset;
+
+		last = f->dataoffset;
+	}
+
+	// The first frame is always a keyframe.
+
+	if (p != end || (count > 0 && !index->frames[0].keyframe)) {
+		goto clean;
+	}
+
+	return index;
+
+clean:
+	FI_FreeIndex (index);
+
+	return NULL;
+}
+
+/*
+  Returns the nearest keyframe at or before "frame".
+*/
+
+unsigned long FI_KeyFrame (frameindex_t* index, unsigned long frame) {
+	while (frame > 0 && !index->frames[frame].keyframe) {
+		frame--;
+	}
+
+	return frame;
+}
+
+/*
+  Renders "frame" onto "*canvas", decoding only the frames from the nearest
+  keyframe on. The canvas is made on the first call if "*canvas" is NULL, and
+  must be that of the same GIF afterwards. "ctx" must be able to move back,
+  as every call starts over from the screen descriptor.
+*/
+
+GBOOL FI_DecodeFrame (context_t* ctx, frameindex_t* index, unsigned long frame, canvas_t** canvas) {
+	gif_t*        gif;
+	image_t*      i;
+	unsigned long key;
+	GBOOL         result;
+
+	if (frame >= index->count) {
+		return GFALSE;
+	}
+
+	key = FI_KeyFrame (index, frame);
+
+	if (!GIF_DecodeRange (ctx, &gif, index->frames[key].offset, frame - key + 1)) {
+		return GFALSE;
+	}
+
+	result = GFALSE;
+
+	if (gif->imagecount != frame - key + 1) {
+		goto clean;
+	}
+
+	if (*canvas == NULL) {
+		if ((*canvas = CV_NewCanvas (gif)) == NULL) {
+			goto clean;
+		}
+	} else if ((*canvas)->width != gif->screenwidth || (*canvas)->height != gif->screenheight) {
+		goto clean;
+	} else {
+		CV_ResetCanvas (*canvas);
+	}
+
+	for (i = gif->images; i; i = i->next) {
+		if (!CV_DrawImage (*canvas, gif, i)) {
+			goto clean;
+		}
+	}
+
+	result = GTRUE;
+
+clean:
+	GIF_FreeGif (gif);
+
+	return result;
+}
@@ -0,0 +1,220 @@
+#include <string.h>
+#include "palette.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define PALETTESIMD
+#endif
+
+// Expansion kernels: table, indexes, output and number of pixels.
+
+typedef void                           (*PK)(const unsigned int*, const GBYTE*, GBYTE*, unsigned long);
+
+typedef struct kernels_s {
+	PK                                 expand4;            // Four-byte pixels.
+	PK                                 expand3;            // RGB pixels.
+	PK                                 draw4;              // Four-byte pixels, transparent ones skipped.
+} kernels_t;
+
+/*
+  Builds the lookup table of "colors" for "format". Each entry is a pixel as
+  laid out in memory; indexes past the color table are opaque black and the
+  transparent index, if any, has zero alpha.
+*/
+
+void P_MakeTable (unsigned int* table, const rgb_t* colors, unsigned long items, GBYTE format, GBOOL transparent, GBYTE trnspindex) {
+	unsigned long k;
+	GBYTE         p[4];
+
+	for (k = 0; k < 256; k++) {
+		if (k < items) {
+			p[0] = format == PIXELBGRA || format == PIXELBGR ? colors[k].blue : colors[k].red;
+			p[1] = colors[k].green;
+			p[2] = format == PIXELBGRA || format == PIXELBGR ? colors[k].red : colors[k].blue;
+		} else {
+			p[0] = 0;
+			p[1] = 0;
+			p[2] = 0;
+		}
+
+		p[3] = (transparent && k == trnspindex) ? 0x00 : 0xFF;
+
+		memcpy (table + k, p, 4);
+	}
+}
+
+void P_Expand4 (const unsigned int* table, const GBYTE* indexes, GBYTE* out, unsigned long count) {
+	unsigned long i;
+
+	for (i = 0; i < count; i++, out += 4) {
+		memcpy (out, table + indexes[i], 4);
+	}
+}
+
+void P_Expand3 (const unsigned int* table, const GBYTE* indexes, GBYTE* out, unsigned long count) {
+	unsigned long i;
+
+	for (i = 0; i < count; i++, out += 3) {
+		memcpy (out, table + indexes[i], 3);
+	}
+}
+
+void P_Draw4 (const unsigned int* table, const GBYTE* indexes, GBYTE* out, unsigned long count) {
+	unsigned long i;
+	const GBYTE*  p;
+
+	for (i = 0; i < count; i++, out += 4) {
+		p = (const GBYTE*) (table + indexes[i]);
+
+		if (p[3]) {
+			memcpy (out, p, 4);
+		}
+	}
+}
+
+#ifdef PALETTESIMD
+
+// AVX2: eight pixels are looked up at once with a gather. Opaque pixels have
+// the top bit of their alpha set, which is what a masked store looks at, so
+// the pixels themselves are the transparency mask.
+
+__attribute__((target("avx2"))) void P_Expand4AVX2 (const unsigned int* table, const GBYTE* indexes, GBYTE* out, unsigned long count) {
+	unsigned long i;
+	__m256i       v;
+
+	for (i = 0; i + 8 <= count; i += 8, out += 32) {
+		v = _mm256_cvtepu8_epi32 (_mm_loadl_epi64 ((const __m128i*) (indexes + i)));
+		v = _mm256_i32gather_epi32 ((const int*) table, v, 4);
+		_mm256_storeu_si256 ((__m256i*) out, v);
+	}
+
+	P_Expand4 (table, indexes + i, out, count - i);
+}
+
+__attribute__((target("avx2"))) void P_Draw4AVX2 (const unsigned int* table, const GBYTE* indexes, GBYTE* out, unsigned long count) {
+	unsigned long i;
+	__m256i       v;
+
+	for (i = 0; i + 8 <= count; i += 8, out += 32) {
+		v = _mm256_cvtepu8_epi32 (_mm_loadl_epi64 ((const __m128i*) (indexes + i)));
+		v = _mm256_i32gather_epi32 ((const int*) table, v, 4);
+		_mm256_maskstore_epi32 ((int*) out, v, v);
+	}
+
+	P_Draw4 (table, indexes + i, out, count - i);
+}
+
+__attribute__((target("avx2"))) void P_Expand3AVX2 (const unsigned int* table, const GBYTE* indexes, GBYTE* out, unsigned long count) {
+	unsigned long i;
+	__m256i       v, pack;
+
+	pack = _mm256_setr_epi8 (0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1, 0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+	// Each lane packs four pixels in its twelve low bytes. Stores are sixteen
+	// bytes wide, so the last pixels are left to the scalar loop to keep them
+	// within the row.
+
+	for (i = 0; i + 10 <= count; i += 8, out += 24) {
+		v = _mm256_cvtepu8_epi32 (_mm_loadl_epi64 ((const __m128i*) (indexes + i)));
+		v = _mm256_i32gather_epi32 ((const int*) table, v, 4);
+		v = _mm256_shuffle_epi8 (v, pack);
+		_mm_storeu_si128 ((__m128i*) out, _mm256_castsi256_si128 (v));
+		_mm_storeu_si128 ((__m128i*) (out + 12), _mm256_extracti128_si256 (v, 1));
+	}
+
+	P_Expand3 (table, indexes + i, out, count - i);
+}
+
+// SSSE3: no gather, but the RGB packing is one shuffle per four pixels.
+
+__attribute__((target("ssse3"))) void P_Expand3SSSE3 (const unsigned int* table, const GBYTE* indexes, GBYTE* out, unsigned long count) {
+	unsigned long i;
+	__m128i       v, pack;
+
+	pack = _mm_setr_epi8 (0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+	// Same as above: stores past the twelve bytes written need two pixels
+	// more in the row.
+
+	for (i = 0; i + 6 <= count; i += 4, out += 12) {
+		v = _mm_setr_epi32 ((int) table[indexes[i]], (int) table[indexes[i + 1]], (int) table[indexes[i + 2]], (int) table[indexes[i + 3]]);
+		_mm_storeu_si128 ((__m128i*) out, _mm_shuffle_epi8 (v, pack));
+	}
+
+	P_Expand3 (table, indexes + i, out, count - i);
+}
+
+#endif
+
+static const kernels_t                 ScalarKernels = {&P_Expand4, &P_Expand3, &P_Draw4};
+
+#ifdef PALETTESIMD
+static const kernels_t                 AVX2Kernels   = {&P_Expand4AVX2, &P_Expand3AVX2, &P_Draw4AVX2};
+static const kernels_t                 SSSE3Kernels  = {&P_Expand4, &P_Expand3SSSE3, &P_Draw4};
+
+// The kernels picked for this processor, NULL until the first call.
+
+static const kernels_t*                Kernels       = NULL;
+#endif
+
+/*
+  Returns the kernels for this processor. The tables never change, only the
+  pointer to the one picked is published, with an atomic store; threads
+  racing on the first call store the same pointer.
+*/
+
+const kernels_t* P_GetKernels (void) {
+#ifdef PALETTESIMD
+	const kernels_t* k;
+
+	if ((k = __atomic_load_n (&Kernels, __ATOMIC_ACQUIRE)) != NULL) {
+		return k;
+	}
+
+	if (__builtin_cpu_supports ("avx2")) {
+		k = &AVX2Kernels;
+	} else if (__builtin_cpu_supports ("ssse3")) {
+		k = &SSSE3Kernels;
+	} else {
+		k = &ScalarKernels;
+	}
+
+	__atomic_store_n (&Kernels, k, __ATOMIC_RELEASE);
+
+	return k;
+#else
+	return &ScalarKernels;
+#endif
+}
+
+/*
+  Expands "count" indexes to pixels of "format" through "table".
+*/
+
+void P_ExpandRow (const unsigned int* table, const GBYTE* indexes, GBYTE* out, unsigned long count, GBYTE format) {
+	if (format == PIXELRGB || format == PIXELBGR) {
+		P_GetKernels ()->expand3 (table, indexes, out, count);
+	} else {
+		P_GetKernels ()->expand4 (table, indexes, out, count);
+	}
+}
+
+/*
+  Same as P_ExpandRow, but pixels with zero alpha in "table" are not written,
+  so what is under them shows through.
+*/
+
+void P_DrawRow (const unsigned int* table, const GBYTE* indexes, GBYTE* out, unsigned long count, GBYTE format) {
+	unsigned long i;
+
+	if (format != PIXELRGB && format != PIXELBGR) {
+		P_GetKernels ()->draw4 (table, indexes, out, count);
+		return;
+	}
+
+	for (i = 0; i < count; i++, out += 3) {
+		if (((const GBYTE*) (table + indexes[i]))[3]) {
+			memcpy (out, table + indexes[i], 3);
+		}
+	}
+}
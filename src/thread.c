@@ -0,0 +1,185 @@
+#include <stdlib.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#endif
+#include "thread.h"
+
+struct thread_s {
+#ifdef _WIN32
+	HANDLE                             handle;
+#else
+	pthread_t                          handle;
+#endif
+	TF                                 f;
+	void*                              arg;
+};
+
+struct mutex_s {
+#ifdef _WIN32
+	CRITICAL_SECTION                   handle;
+#else
+	pthread_mutex_t                    handle;
+#endif
+};
+
+#ifdef _WIN32
+DWORD WINAPI T_Start (LPVOID thread) {
+	((thread_t*) thread)->f (((thread_t*) thread)->arg);
+
+	return 0;
+}
+#else
+void* T_Start (void* thread) {
+	((thread_t*) thread)->f (((thread_t*) thread)->arg);
+
+	return NULL;
+}
+#endif
+
+thread_t* T_NewThread (TF f, void* arg) {
+	thread_t* t;
+
+	if ((t = (thread_t*) malloc (sizeof (thread_t))) == NULL) {
+		return NULL;
+	}
+
+	t->f   = f;
+	t->arg = arg;
+
+#ifdef _WIN32
+	if ((t->handle = CreateThread (NULL, 0, &T_Start, t, 0, NULL)) == NULL) {
+		goto clean;
+	}
+#else
+	if (pthread_create (&t->handle, NULL, &T_Start, t) != 0) {
+		goto clean;
+	}
+#endif
+
+	return t;
+
+clean:
+	free (t);
+
+	return NULL;
+}
+
+/*
+  Waits for the thread to finish and releases it.
+*/
+
+void T_JoinThread (thread_t* thread) {
+	if (thread) {
+#ifdef _WIN32
+		WaitForSingleObject (thread->handle, INFINITE);
+		CloseHandle (thread->handle);
+#else
+		pthread_join (thread->handle, NULL);
+#endif
+
+		free (thread);
+	}
+}
+
+/*
+  Atomically increments "value" and returns the incremented value.
+*/
+
+long T_Increment (volatile long* value) {
+#ifdef _WIN32
+	return InterlockedIncrement (value);
+#else
+	return __sync_add_and_fetch (value, 1);
+#endif
+}
+
+/*
+  Reads and writes "value", seen at once by the other threads.
+*/
+
+long T_Load (volatile long* value) {
+#ifdef _WIN32
+	return InterlockedCompareExchange (value, 0, 0);
+#else
+	return __atomic_load_n (value, __ATOMIC_ACQUIRE);
+#endif
+}
+
+void T_Store (volatile long* value, long v) {
+#ifdef _WIN32
+	InterlockedExchange (value, v);
+#else
+	__atomic_store_n (value, v, __ATOMIC_RELEASE);
+#endif
+}
+
+mutex_t* T_NewMutex (void) {
+	mutex_t* m;
+
+	if ((m = (mutex_t*) malloc (sizeof (mutex_t))) == NULL) {
+		return NULL;
+	}
+
+#ifdef _WIN32
+	InitializeCriticalSection (&m->handle);
+#else
+	if (pthread_mutex_init (&m->handle, NULL) != 0) {
+		free (m);
+		return NULL;
+	}
+#endif
+
+	return m;
+}
+
+void T_FreeMutex (mutex_t* mutex) {
+	if (mutex) {
+#ifdef _WIN32
+		DeleteCriticalSection (&mutex->handle);
+#else
+		pthread_mutex_destroy (&mutex->handle);
+#endif
+
+		free (mutex);
+	}
+}
+
+void T_Lock (mutex_t* mutex) {
+#ifdef _WIN32
+	EnterCriticalSection (&mutex->handle);
+#else
+	pthread_mutex_lock (&mutex->handle);
+#endif
+}
+
+void T_Unlock (mutex_t* mutex) {
+#ifdef _WIN32
+	LeaveCriticalSection (&mutex->handle);
+#else
+	pthread_mutex_unlock (&mutex->handle);
+#endif
+}
+
+/*
+  Monotonic time in nanoseconds, to measure intervals with.
+*/
+
+unsigned long long T_Time (void) {
+#ifdef _WIN32
+	LARGE_INTEGER t, f;
+
+	QueryPerformanceCounter (&t);
+	QueryPerformanceFrequency (&f);
+
+	return (unsigned long long) (t.QuadPart / f.QuadPart) * 1000000000ULL + (unsigned long long) (t.QuadPart % f.QuadPart) * 1000000000ULL / f.QuadPart;
+#else
+	struct timespec t;
+
+	clock_gettime (CLOCK_MONOTONIC, &t);
+
+	return (unsigned long long) t.tv_sec * 1000000000ULL + t.tv_nsec;
+#endif
+}
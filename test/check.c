@@ -0,0 +1,291 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "check.h"
+
+// Runs the checks named on the command line, or all of them, and exits with
+// the number of those failing.
+
+typedef struct check_s {
+	const char*                        name;
+	CF                                 f;
+} check_t;
+
+static const check_t                   Checks[] = {
+	{"encode",    &CK_EncodeRoundTrip},
+	{"reencode",  &CK_EncodeAgain},
+	{"redecode",  &CK_DecodeAgain},
+	{"threads",   &CK_DecodeThreaded},
+	{"push",      &CK_PushAnySize},
+	{"stripes",   &CK_EncodeStripes},
+	{"index",     &CK_IndexFrames},
+	{"cache",     &CK_CacheEviction},
+	{"kernels",   &CK_PaletteKernels},
+	{"rows",      &CK_PaletteRows},
+	{"scale",     &CK_ScaleImages},
+	{"stream",    &CK_StreamImages},
+	{"arena",     &CK_ArenaDecode},
+	{"limits",    &CK_DecodeLimits},
+	{"tolerant",  &CK_DecodeTolerant},
+	{"stats",     &CK_DecodeStats}
+};
+
+#define CHECKS                         (sizeof (Checks) / sizeof (Checks[0]))
+
+static unsigned long                   Seed;
+static unsigned long                   Failures;
+
+GBOOL CK_Check (GBOOL ok, const char* what, const char* file, int line) {
+	if (!ok) {
+		printf ("\n  %s:%d: %s", file, line, what);
+		Failures++;
+	}
+
+	return ok;
+}
+
+unsigned long CK_Random (void) {
+	Seed = Seed * 1103515245UL + 12345UL;
+
+	return (Seed >> 16) & 0x7FFF;
+}
+
+GBOOL CK_Write (void* user, const void* ptr, unsigned long count) {
+	buffer_t* b;
+
+	b = (buffer_t*) user;
+
+	if (!B_ReserveBuffer (b, b->size + count)) {
+		return GFALSE;
+	}
+
+	memcpy ((GBYTE*) b->data + b->size, ptr, count);
+	b->size += count;
+
+	return GTRUE;
+}
+
+/*
+  Returns an empty GIF with a global color table of random colors.
+*/
+
+gif_t* CK_NewGif (UNSIGNED width, UNSIGNED height) {
+	gif_t* gif;
+
+	if ((gif = (gif_t*) calloc (1, sizeof (gif_t))) == NULL) {
+		return NULL;
+	}
+
+	A_DefaultAllocator (&gif->allocator);
+
+	gif->screenwidth  = width;
+	gif->screenheight = height;
+	gif->gctsize      = 256;
+
+	if ((gif->gct = CK_NewColorTable (gif, 256)) == NULL) {
+		GIF_FreeGif (gif);
+		return NULL;
+	}
+
+	return gif;
+}
+
+rgb_t* CK_NewColorTable (gif_t* gif, UNSIGNED items) {
+	rgb_t*        table;
+	unsigned long k;
+
+	if ((table = (rgb_t*) A_Alloc (&gif->allocator, sizeof (rgb_t) * items)) == NULL) {
+		return NULL;
+	}
+
+	for (k = 0; k < items; k++) {
+		table[k].red   = (GBYTE) CK_Random ();
+		table[k].green = (GBYTE) CK_Random ();
+		table[k].blue  = (GBYTE) CK_Random ();
+	}
+
+	return table;
+}
+
+/*
+  Appends an image of indexes below "colors" to "gif": flat areas with some
+  noise on top, so it compresses to long strings and fills the code table.
+*/
+
+image_t* CK_AddImage (gif_t* gif, UNSIGNED left, UNSIGNED top, UNSIGNED width, UNSIGNED height, unsigned int colors) {
+	image_t*      i;
+	image_t*      last;
+	GBYTE*        p;
+	unsigned long x, y;
+
+	if ((i = (image_t*) A_Alloc (&gif->allocator, sizeof (image_t))) == NULL) {
+		return NULL;
+	}
+
+	memset (i, 0, sizeof (image_t));
+
+	if ((i->indexes = B_AllocBuffer (&gif->allocator, (unsigned long) width * height)) == NULL) {
+		A_Free (&gif->allocator, i);
+		return NULL;
+	}
+
+	i->left          = left;
+	i->top           = top;
+	i->width         = width;
+	i->height        = height;
+	i->indexes->size = (unsigned long) width * height;
+
+	for (p = (GBYTE*) i->indexes->data, y = 0; y < height; y++) {
+		for (x = 0; x < width; x++, p++) {
+			*p = (GBYTE) ((x / 8 + y / 6 * 3) % colors);
+
+			if (CK_Random () % 8 == 0) {
+				*p = (GBYTE) (CK_Random () % colors);
+			}
+		}
+	}
+
+	for (last = gif->images; last && last->next; last = last->next);
+
+	if (last) {
+		last->next = i;
+	} else {
+		gif->images = i;
+	}
+
+	gif->imagecount++;
+
+	return i;
+}
+
+/*
+  Returns an animation of "frames" frames over a 160x120 screen. Every tenth
+  frame, the first one included, covers the screen; the others are updates of
+  random sizes and places. Every few frames is interlaced, transparent or has
+  a local table.
+*/
+
+gif_t* CK_NewAnimation (unsigned long frames) {
+	gif_t*        gif;
+	image_t*      i;
+	unsigned long k;
+	UNSIGNED      width, height;
+
+	if ((gif = CK_NewGif (160, 120)) == NULL) {
+		return NULL;
+	}
+
+	gif->loop = GTRUE;
+
+	for (k = 0; k < frames; k++) {
+		width  = (UNSIGNED) (k % 10 > 0 ? 1 + CK_Random () % 160 : 160);
+		height = (UNSIGNED) (k % 10 > 0 ? 1 + CK_Random () % 120 : 120);
+
+		// Indexes stay within the local table, when there is one.
+
+		if ((i = CK_AddImage (gif, (UNSIGNED) (CK_Random () % (161 - width)), (UNSIGNED) (CK_Random () % (121 - height)), width, height, 1 + CK_Random () % (k % 7 == 2 ? 64 : 256))) == NULL) {
+			goto clean;
+		}
+
+		i->delaytime   = 4;
+		i->disposal    = (GBYTE) (CK_Random () % 4);
+		i->interlaced  = k % 5 == 3 ? GTRUE : GFALSE;
+		i->transparent = k % 3 == 1 ? GTRUE : GFALSE;
+		i->trnspindex  = (GBYTE) CK_Random ();
+
+		if (k % 7 == 2) {
+			if ((i->lct = CK_NewColorTable (gif, 64)) == NULL) {
+				goto clean;
+			}
+
+			i->lctsize = 64;
+		}
+	}
+
+	return gif;
+
+clean:
+	GIF_FreeGif (gif);
+
+	return NULL;
+}
+
+/*
+  Encodes "gif" with "threads" threads. Returns the stream, or NULL.
+*/
+
+buffer_t* CK_Encode (gif_t* gif, unsigned int threads) {
+	buffer_t* b;
+
+	if ((b = B_AllocBuffer (NULL, 1 << 16)) == NULL) {
+		return NULL;
+	}
+
+	b->size = 0;
+
+	if (!GIF_WriteStream (gif, &CK_Write, b, threads)) {
+		B_FreeBuffer (b);
+		return NULL;
+	}
+
+	return b;
+}
+
+/*
+  Tells whether "a" and "b" hold the same images, as drawn.
+*/
+
+GBOOL CK_SameImages (gif_t* a, gif_t* b) {
+	image_t* i;
+	image_t* j;
+	GBOOL    ok;
+
+	ok = CHECK (a->imagecount == b->imagecount);
+
+	for (i = a->images, j = b->images; i && j && ok; i = i->next, j = j->next) {
+		ok = CHECK (i->left == j->left && i->top == j->top && i->width == j->width && i->height == j->height)
+			&& CHECK (i->delaytime == j->delaytime && i->disposal == j->disposal && i->userinput == j->userinput)
+			&& CHECK (i->transparent == j->transparent && (!i->transparent || i->trnspindex == j->trnspindex))
+			&& CHECK (i->interlaced == j->interlaced && i->sorted == j->sorted)
+			&& CHECK (i->lctsize == j->lctsize && (i->lctsize == 0 || !memcmp (i->lct, j->lct, sizeof (rgb_t) * i->lctsize)))
+			&& CHECK (i->indexes && j->indexes && i->indexes->size == j->indexes->size)
+			&& CHECK (!memcmp (i->indexes->data, j->indexes->data, (unsigned long) i->width * i->height));
+	}
+
+	return ok && CHECK (i == NULL && j == NULL);
+}
+
+int main (int argc, char** argv) {
+	unsigned long k, before;
+	GBOOL         selected;
+	int           a, failed;
+
+	failed = 0;
+
+	for (k = 0; k < CHECKS; k++) {
+		for (a = 1, selected = argc <= 1; a < argc; a++) {
+			if (!strcmp (argv[a], Checks[k].name)) {
+				selected = GTRUE;
+			}
+		}
+
+		if (!selected) {
+			continue;
+		}
+
+		printf ("%-10s", Checks[k].name);
+		fflush (stdout);
+
+		Seed   = 1;
+		before = Failures;
+
+		if (!Checks[k].f () || Failures != before) {
+			printf ("\n%-10s failed\n", Checks[k].name);
+			failed++;
+		} else {
+			printf (" ok\n");
+		}
+	}
+
+	return failed;
+}
@@ -0,0 +1,44 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+#include "gif.h"
+
+// Behavior checks of the library, run by "make test". A check returns GFALSE
+// when it cannot go on; every condition it tests goes through CHECK(), which
+// reports the ones failing along with where they are.
+
+#define CHECK(c)                       CK_Check ((c) ? GTRUE : GFALSE, #c, __FILE__, __LINE__)
+
+typedef GBOOL                          (*CF)(void);
+
+	GBOOL                              CK_Check (GBOOL ok, const char* what, const char* file, int line);
+	unsigned long                      CK_Random (void);
+	GBOOL                              CK_Write (void* user, const void* ptr, unsigned long count);
+	gif_t*                             CK_NewGif (UNSIGNED width, UNSIGNED height);
+	rgb_t*                             CK_NewColorTable (gif_t* gif, UNSIGNED items);
+	image_t*                           CK_AddImage (gif_t* gif, UNSIGNED left, UNSIGNED top, UNSIGNED width, UNSIGNED height, unsigned int colors);
+	gif_t*                             CK_NewAnimation (unsigned long frames);
+	buffer_t*                          CK_Encode (gif_t* gif, unsigned int threads);
+	GBOOL                              CK_SameImages (gif_t* a, gif_t* b);
+	gif_t*                             CK_MakeEncodeGif (void);
+
+// The checks, in a file per feature.
+
+	GBOOL                              CK_EncodeRoundTrip (void);
+	GBOOL                              CK_EncodeAgain (void);
+	GBOOL                              CK_DecodeAgain (void);
+	GBOOL                              CK_DecodeThreaded (void);
+	GBOOL                              CK_PushAnySize (void);
+	GBOOL                              CK_EncodeStripes (void);
+	GBOOL                              CK_IndexFrames (void);
+	GBOOL                              CK_CacheEviction (void);
+	GBOOL                              CK_PaletteKernels (void);
+	GBOOL                              CK_PaletteRows (void);
+	GBOOL                              CK_ScaleImages (void);
+	GBOOL                              CK_StreamImages (void);
+	GBOOL                              CK_ArenaDecode (void);
+	GBOOL                              CK_DecodeLimits (void);
+	GBOOL                              CK_DecodeTolerant (void);
+	GBOOL                              CK_DecodeStats (void);
+
+#endif
@@ -0,0 +1,228 @@
+#include <stdlib.h>
+#include "check.h"
+
+// Allocator over malloc counting the blocks it holds.
+
+typedef struct counter_s {
+	long                               blocks;             // Blocks allocated and not freed.
+	unsigned long                      allocations;
+} counter_t;
+
+void* CK_CountAlloc (void* user, unsigned long size) {
+	counter_t* c;
+
+	c = (counter_t*) user;
+	c->blocks++;
+	c->allocations++;
+
+	return malloc (size);
+}
+
+void* CK_CountResize (void* user, void* ptr, unsigned long oldsize, unsigned long size) {
+	counter_t* c;
+
+	c = (counter_t*) user;
+
+	if (ptr == NULL) {
+		c->blocks++;
+	}
+
+	c->allocations++;
+
+	return realloc (ptr, size);
+}
+
+void CK_CountFree (void* user, void* ptr) {
+	if (ptr) {
+		((counter_t*) user)->blocks--;
+	}
+
+	free (ptr);
+}
+
+/*
+  Tells whether "gif" and the buffers of its images come from "a".
+*/
+
+GBOOL CK_FromAllocator (gif_t* gif, const allocator_t* a) {
+	image_t* i;
+	GBOOL    ok;
+
+	ok = CHECK (gif->allocator.alloc == a->alloc && gif->allocator.user == a->user);
+
+	for (i = gif->images; i && ok; i = i->next) {
+		ok = CHECK (i->indexes && i->indexes->allocator.alloc == a->alloc && i->indexes->allocator.user == a->user);
+	}
+
+	return ok;
+}
+
+/*
+  Decodes "data" from memory with "threads" threads and the allocator "a".
+  Returns the GIF, or NULL with the error of the decode in "error".
+*/
+
+gif_t* CK_DecodeInto (const buffer_t* data, unsigned int threads, const allocator_t* a, unsigned int* error) {
+	context_t* ctx;
+	gif_t*     gif;
+
+	if ((ctx = GIF_NewMemoryContext ((const GBYTE*) data->data, data->size)) == NULL) {
+		return NULL;
+	}
+
+	GIF_SetThreads (ctx, threads);
+	GIF_SetAllocator (ctx, a);
+
+	if (!GIF_Decode (ctx, &gif)) {
+		gif = NULL;
+	}
+
+	*error = GIF_GetError (ctx);
+
+	GIF_FreeContext (ctx);
+
+	return gif;
+}
+
+/*
+  Pushes "data" in chunks of random sizes with the allocator "a" set after
+  the context is made. Returns the GIF, or NULL with the error in "error".
+*/
+
+gif_t* CK_PushInto (const buffer_t* data, const allocator_t* a, unsigned int* error) {
+	context_t*    ctx;
+	gif_t*        gif;
+	unsigned long offset, n;
+
+	if ((ctx = GIF_NewPushContext (NULL, NULL)) == NULL) {
+		return NULL;
+	}
+
+	GIF_SetAllocator (ctx, a);
+
+	for (offset = 0, gif = NULL; offset < data->size; offset += n) {
+		n = 1 + CK_Random () % 1000;
+
+		if (n > data->size - offset) {
+			n = data->size - offset;
+		}
+
+		if (!GIF_Push (ctx, (const GBYTE*) data->data + offset, n)) {
+			goto clean;
+		}
+	}
+
+	if (!GIF_EndPush (ctx, &gif)) {
+		gif = NULL;
+	}
+
+clean:
+	*error = GIF_GetError (ctx);
+
+	GIF_FreeContext (ctx);
+
+	return gif;
+}
+
+/*
+  GIFs decoded through an allocator take every block from it and give every
+  one back when freed. Decoded into an arena, with any number of threads or
+  pushed, they are those of a plain decode, over chunks smaller than their
+  images and again once the arena is reset.
+*/
+
+GBOOL CK_ArenaDecode (void) {
+	static const unsigned long chunks[] = {100, 4096, 1 << 20};
+	gif_t*                     gif;
+	gif_t*                     full;
+	gif_t*                     back;
+	buffer_t*                  data;
+	arena_t*                   arena;
+	allocator_t                a;
+	counter_t                  counter;
+	unsigned long              k, round;
+	unsigned int               threads, error;
+
+	if (!CHECK ((gif = CK_NewAnimation (40)) != NULL)) {
+		return GFALSE;
+	}
+
+	data = CK_Encode (gif, 1);
+	full = NULL;
+
+	GIF_FreeGif (gif);
+
+	if (!CHECK (data != NULL) || !CHECK (GIF_ProcessMemory (&full, (const GBYTE*) data->data, data->size))) {
+		goto clean;
+	}
+
+	// Every block of the GIF from the allocator, decoded or pushed.
+
+	a.alloc  = &CK_CountAlloc;
+	a.resize = &CK_CountResize;
+	a.free   = &CK_CountFree;
+	a.user   = &counter;
+
+	for (threads = 1; threads <= 8; threads *= 2) {
+		counter.blocks      = 0;
+		counter.allocations = 0;
+
+		if (CHECK ((back = CK_DecodeInto (data, threads, &a, &error)) != NULL) && CHECK (error == ERRORNONE)) {
+			CK_SameImages (full, back);
+			CK_FromAllocator (back, &a);
+			CHECK (counter.allocations > full->imagecount && counter.blocks > 0);
+			GIF_FreeGif (back);
+			CHECK (counter.blocks == 0);
+		}
+	}
+
+	counter.blocks = 0;
+
+	if (CHECK ((back = CK_PushInto (data, &a, &error)) != NULL) && CHECK (error == ERRORNONE)) {
+		CK_SameImages (full, back);
+		CK_FromAllocator (back, &a);
+		GIF_FreeGif (back);
+		CHECK (counter.blocks == 0);
+	}
+
+	// Arenas, whose GIFs are released with them.
+
+	for (k = 0; k < sizeof (chunks) / sizeof (chunks[0]); k++) {
+		if (!CHECK ((arena = A_NewArena (chunks[k])) != NULL)) {
+			continue;
+		}
+
+		A_ArenaAllocator (arena, &a);
+
+		for (round = 0; round < 2; round++) {
+			for (threads = 1; threads <= 8; threads++) {
+				if (CHECK ((back = CK_DecodeInto (data, threads, &a, &error)) != NULL) && CHECK (error == ERRORNONE)) {
+					CK_SameImages (full, back);
+					CK_FromAllocator (back, &a);
+					GIF_FreeGif (back);
+				}
+			}
+
+			if (CHECK ((back = CK_PushInto (data, &a, &error)) != NULL) && CHECK (error == ERRORNONE)) {
+				CK_SameImages (full, back);
+				CK_FromAllocator (back, &a);
+				GIF_FreeGif (back);
+			}
+
+			A_ResetArena (arena);
+		}
+
+		A_FreeArena (arena);
+	}
+
+clean:
+	if (full) {
+		GIF_FreeGif (full);
+	}
+
+	if (data) {
+		B_FreeBuffer (data);
+	}
+
+	return GTRUE;
+}
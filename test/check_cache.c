@@ -0,0 +1,236 @@
+#include <stdlib.h>
+#include <string.h>
+#include "check.h"
+#include "cache.h"
+#include "thread.h"
+
+#define FRAMESIZE                      1000
+#define WORKERS                        4
+
+// Frames are filled with bytes telling which GIF and frame they are of, so a
+// frame handed out for another is seen.
+
+typedef struct worker_s {
+	framecache_t*                      cache;
+	unsigned long                      seed;
+	unsigned long                      errors;             // Frames found with the contents of another.
+} worker_t;
+
+void CK_FillFrame (GBYTE* data, unsigned long long hash, unsigned long frame, unsigned long size) {
+	unsigned long k;
+
+	for (k = 0; k < size; k++) {
+		data[k] = (GBYTE) (hash * 7 + frame * 13 + k);
+	}
+}
+
+GBOOL CK_IsFrame (cachedframe_t* f, unsigned long long hash, unsigned long frame) {
+	unsigned long k;
+
+	if (f == NULL || f->hash != hash || f->frame != frame) {
+		return GFALSE;
+	}
+
+	for (k = 0; k < f->size; k++) {
+		if (f->data[k] != (GBYTE) (hash * 7 + frame * 13 + k)) {
+			return GFALSE;
+		}
+	}
+
+	return GTRUE;
+}
+
+/*
+  Inserts frame "frame" of the GIF hashed as "hash" and releases it.
+*/
+
+GBOOL CK_InsertFrame (framecache_t* cache, unsigned long long hash, unsigned long frame, unsigned long size) {
+	GBYTE          data[FRAMESIZE];
+	cachedframe_t* f;
+	GBOOL          ok;
+
+	CK_FillFrame (data, hash, frame, size);
+
+	ok = (f = FC_Insert (cache, hash, frame, data, size)) != NULL && CK_IsFrame (f, hash, frame);
+
+	FC_Release (cache, f);
+
+	return ok;
+}
+
+/*
+  Tells whether frame "frame" of the GIF hashed as "hash" is cached.
+*/
+
+GBOOL CK_Cached (framecache_t* cache, unsigned long long hash, unsigned long frame) {
+	cachedframe_t* f;
+	GBOOL          ok;
+
+	if ((f = FC_Lookup (cache, hash, frame)) == NULL) {
+		return GFALSE;
+	}
+
+	ok = CK_IsFrame (f, hash, frame);
+
+	FC_Release (cache, f);
+
+	return ok;
+}
+
+/*
+  Looks up random frames of a few GIFs, inserting those missing, in a cache
+  too small for all of them.
+*/
+
+void CK_CacheWorker (void* arg) {
+	worker_t*      w;
+	cachedframe_t* f;
+	GBYTE          data[FRAMESIZE];
+	unsigned long  k, frame;
+
+	w = (worker_t*) arg;
+
+	for (k = 0; k < 20000; k++) {
+		w->seed = w->seed * 1103515245UL + 12345UL;
+		frame   = (w->seed >> 16) % 64;
+
+		if ((f = FC_Lookup (w->cache, frame % 3, frame)) == NULL) {
+			CK_FillFrame (data, frame % 3, frame, FRAMESIZE);
+			f = FC_Insert (w->cache, frame % 3, frame, data, FRAMESIZE);
+		}
+
+		if (!CK_IsFrame (f, frame % 3, frame)) {
+			w->errors++;
+		}
+
+		FC_Release (w->cache, f);
+	}
+}
+
+/*
+  Frames are evicted least recently used first once over the budget, frames
+  held stay valid after their eviction, and frames larger than the budget are
+  not kept. Many threads sharing a cache get the frames they asked for.
+*/
+
+GBOOL CK_CacheEviction (void) {
+	framecache_t*  cache;
+	cachedframe_t* held;
+	cachedframe_t* again;
+	thread_t*      threads[WORKERS];
+	worker_t       workers[WORKERS];
+	GBYTE          data[FRAMESIZE];
+	GBYTE*         big;
+	unsigned long  k, size;
+
+	// Room for four frames exactly.
+
+	if (!CHECK ((cache = FC_NewCache (4 * (sizeof (cachedframe_t) + FRAMESIZE))) != NULL)) {
+		return GFALSE;
+	}
+
+	for (k = 0; k < 4; k++) {
+		CHECK (CK_InsertFrame (cache, 1, k, FRAMESIZE));
+	}
+
+	for (k = 0; k < 4; k++) {
+		CHECK (CK_Cached (cache, 1, k));
+	}
+
+	// Frame 0 was used last, so frame 1 goes first. Looking the others up
+	// leaves frame 0 the least recently used, to go next.
+
+	CHECK (CK_Cached (cache, 1, 0));
+	CHECK (CK_InsertFrame (cache, 1, 4, FRAMESIZE));
+	CHECK (!CK_Cached (cache, 1, 1));
+	CHECK (CK_Cached (cache, 1, 0) && CK_Cached (cache, 1, 2) && CK_Cached (cache, 1, 3) && CK_Cached (cache, 1, 4));
+
+	CHECK (CK_InsertFrame (cache, 1, 5, FRAMESIZE));
+	CHECK (!CK_Cached (cache, 1, 0) && CK_Cached (cache, 1, 2));
+
+	// The same frame of another GIF is another frame.
+
+	CHECK (!CK_Cached (cache, 2, 3));
+
+	// A frame held while evicted keeps its data until released.
+
+	held = FC_Lookup (cache, 1, 3);
+
+	for (k = 10; k < 14; k++) {
+		CHECK (CK_InsertFrame (cache, 1, k, FRAMESIZE));
+	}
+
+	CHECK (!CK_Cached (cache, 1, 3));
+	CHECK (CK_IsFrame (held, 1, 3) && !held->cached);
+	FC_Release (cache, held);
+
+	// A frame inserted twice is kept once.
+
+	CK_FillFrame (data, 1, 13, FRAMESIZE);
+	held  = FC_Lookup (cache, 1, 13);
+	again = FC_Insert (cache, 1, 13, data, FRAMESIZE);
+
+	CHECK (held != NULL && again == held && held->refs == 2);
+	FC_Release (cache, held);
+	FC_Release (cache, again);
+
+	// A frame over the budget is handed out but not kept, and evicts nothing.
+
+	size = 5 * (sizeof (cachedframe_t) + FRAMESIZE);
+
+	if ((big = (GBYTE*) malloc (size)) != NULL) {
+		CK_FillFrame (big, 3, 0, size);
+		held = FC_Insert (cache, 3, 0, big, size);
+
+		CHECK (CK_IsFrame (held, 3, 0) && !held->cached);
+		CHECK (!CK_Cached (cache, 3, 0) && CK_Cached (cache, 1, 10));
+
+		FC_Release (cache, held);
+		free (big);
+	}
+
+	FC_FreeCache (cache);
+
+	// More frames than buckets, all kept with a large budget.
+
+	if (!CHECK ((cache = FC_NewCache (1000 * (sizeof (cachedframe_t) + 100))) != NULL)) {
+		return GFALSE;
+	}
+
+	for (k = 0; k < 1000; k++) {
+		CHECK (CK_InsertFrame (cache, k % 5, k, 100));
+	}
+
+	for (k = 0; k < 1000; k++) {
+		CHECK (CK_Cached (cache, k % 5, k));
+	}
+
+	FC_FreeCache (cache);
+
+	// Threads sharing a cache holding a quarter of the frames.
+
+	if (!CHECK ((cache = FC_NewCache (16 * (sizeof (cachedframe_t) + FRAMESIZE))) != NULL)) {
+		return GFALSE;
+	}
+
+	for (k = 0; k < WORKERS; k++) {
+		workers[k].cache  = cache;
+		workers[k].seed   = k + 1;
+		workers[k].errors = 0;
+		threads[k]        = T_NewThread (&CK_CacheWorker, workers + k);
+	}
+
+	for (k = 0; k < WORKERS; k++) {
+		if (threads[k]) {
+			T_JoinThread (threads[k]);
+		} else {
+			CK_CacheWorker (workers + k);
+		}
+
+		CHECK (workers[k].errors == 0);
+	}
+
+	FC_FreeCache (cache);
+
+	return GTRUE;
+}
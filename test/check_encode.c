@@ -0,0 +1,364 @@
+#include <string.h>
+#include "check.h"
+
+/*
+  Adds a comment, an application or a plain text read after "image" images.
+  The lists hold the last one read first, so they are added in stream order.
+*/
+
+GBOOL CK_AddComment (gif_t* gif, const char* text, unsigned long image) {
+	comment_t* c;
+
+	if ((c = (comment_t*) A_Alloc (&gif->allocator, sizeof (comment_t))) == NULL || (c->comment = (char*) A_Alloc (&gif->allocator, strlen (text) + 1)) == NULL) {
+		return GFALSE;
+	}
+
+	strcpy (c->comment, text);
+	c->image      = image;
+	c->next       = gif->comments;
+	gif->comments = c;
+
+	return GTRUE;
+}
+
+GBOOL CK_AddApp (gif_t* gif, const char* appid, const char* data, unsigned long image) {
+	app_t* a;
+
+	if ((a = (app_t*) A_Alloc (&gif->allocator, sizeof (app_t))) == NULL || (a->data = (GBYTE*) A_Alloc (&gif->allocator, strlen (data))) == NULL) {
+		return GFALSE;
+	}
+
+	memcpy (a->appid, appid, APPLICATIONIDSIZE);
+	memcpy (a->authcode, appid + APPLICATIONIDSIZE, APPLICATIONAUTHCODESIZE);
+	memcpy (a->data, data, strlen (data));
+	a->size   = strlen (data);
+	a->image  = image;
+	a->next   = gif->apps;
+	gif->apps = a;
+
+	return GTRUE;
+}
+
+GBOOL CK_AddText (gif_t* gif, const char* text, unsigned long image) {
+	text_t* t;
+
+	if ((t = (text_t*) A_Alloc (&gif->allocator, sizeof (text_t))) == NULL) {
+		return GFALSE;
+	}
+
+	memset (t, 0, sizeof (text_t));
+
+	if ((t->text = (char*) A_Alloc (&gif->allocator, strlen (text) + 1)) == NULL) {
+		return GFALSE;
+	}
+
+	strcpy (t->text, text);
+	t->left       = 8;
+	t->top        = 16;
+	t->width      = 64;
+	t->height     = 16;
+	t->cellwidth  = 8;
+	t->cellheight = 16;
+	t->foreground = 1;
+	t->delaytime  = 50;
+	t->image      = image;
+	t->next       = gif->texts;
+	gif->texts    = t;
+
+	return GTRUE;
+}
+
+/*
+  Builds a GIF going through most of what the encoder writes: a large noisy
+  image filling the code table, local color tables of a few sizes,
+  transparency, an interlaced image, a single pixel, looping, and extensions
+  before, between and after the images.
+*/
+
+gif_t* CK_MakeEncodeGif (void) {
+	gif_t*   gif;
+	image_t* i;
+
+	if ((gif = CK_NewGif (320, 240)) == NULL) {
+		return NULL;
+	}
+
+	gif->loop      = GTRUE;
+	gif->loopcount = 3;
+
+	if ((i = CK_AddImage (gif, 0, 0, 320, 240, 256)) == NULL) {
+		goto clean;
+	}
+
+	if ((i = CK_AddImage (gif, 10, 20, 97, 31, 16)) == NULL || (i->lct = CK_NewColorTable (gif, 16)) == NULL) {
+		goto clean;
+	}
+
+	i->lctsize     = 16;
+	i->transparent = GTRUE;
+	i->trnspindex  = 5;
+	i->delaytime   = 7;
+	i->disposal    = 2;
+
+	if ((i = CK_AddImage (gif, 0, 100, 200, 77, 2)) == NULL || (i->lct = CK_NewColorTable (gif, 2)) == NULL) {
+		goto clean;
+	}
+
+	i->lctsize    = 2;
+	i->interlaced = GTRUE;
+	i->disposal   = 3;
+	i->userinput  = GTRUE;
+
+	if ((i = CK_AddImage (gif, 319, 239, 1, 1, 256)) == NULL) {
+		goto clean;
+	}
+
+	i->delaytime = 100;
+
+	if (!CK_AddComment (gif, "hello", 0) || !CK_AddComment (gif, "second", 0) || !CK_AddComment (gif, "middle", 2) || !CK_AddComment (gif, "last", 4)) {
+		goto clean;
+	}
+
+	if (!CK_AddApp (gif, "CHECKAPP1.0", "first", 1) || !CK_AddApp (gif, "CHECKAPP2.0", "second", 3)) {
+		goto clean;
+	}
+
+	if (!CK_AddText (gif, "title", 0) || !CK_AddText (gif, "caption", 2)) {
+		goto clean;
+	}
+
+	return gif;
+
+clean:
+	GIF_FreeGif (gif);
+
+	return NULL;
+}
+
+/*
+  Tells whether "a" and "b" hold the same comments, applications and plain
+  texts, each after as many images. Made up looping applications of "b" are
+  skipped.
+*/
+
+GBOOL CK_SameExtensions (gif_t* a, gif_t* b) {
+	comment_t* c;
+	comment_t* d;
+	app_t*     p;
+	app_t*     q;
+	text_t*    t;
+	text_t*    u;
+	GBOOL      ok;
+
+	for (c = a->comments, d = b->comments, ok = GTRUE; c && d && ok; c = c->next, d = d->next) {
+		ok = CHECK (!strcmp (c->comment, d->comment) && c->image == d->image);
+	}
+
+	ok = ok && CHECK (c == NULL && d == NULL);
+
+	for (p = a->apps, q = b->apps; p && q && ok; p = p->next, q = q->next) {
+		if (!memcmp (q->appid, "NETSCAPE", APPLICATIONIDSIZE) && memcmp (p->appid, "NETSCAPE", APPLICATIONIDSIZE)) {
+			q = q->next;
+		}
+
+		ok = CHECK (q != NULL) && CHECK (!memcmp (p->appid, q->appid, APPLICATIONIDSIZE) && !memcmp (p->authcode, q->authcode, APPLICATIONAUTHCODESIZE))
+			&& CHECK (p->size == q->size && !memcmp (p->data, q->data, p->size) && p->image == q->image);
+	}
+
+	ok = ok && CHECK (p == NULL && (q == NULL || (!memcmp (q->appid, "NETSCAPE", APPLICATIONIDSIZE) && q->next == NULL)));
+
+	for (t = a->texts, u = b->texts; t && u && ok; t = t->next, u = u->next) {
+		ok = CHECK (!strcmp (t->text, u->text) && t->image == u->image && t->delaytime == u->delaytime);
+	}
+
+	return ok && CHECK (t == NULL && u == NULL);
+}
+
+/*
+  A GIF built by hand decodes back to the same images and metadata.
+*/
+
+GBOOL CK_EncodeRoundTrip (void) {
+	gif_t*    gif;
+	gif_t*    back;
+	buffer_t* data;
+	GBOOL     ok;
+
+	if (!CHECK ((gif = CK_MakeEncodeGif ()) != NULL)) {
+		return GFALSE;
+	}
+
+	ok = CHECK ((data = CK_Encode (gif, 1)) != NULL);
+
+	if (ok && CHECK (GIF_ProcessMemory (&back, (const GBYTE*) data->data, data->size))) {
+		CK_SameImages (gif, back);
+
+		CHECK (back->screenwidth == 320 && back->screenheight == 240);
+		CHECK (back->gctsize == 256 && !memcmp (back->gct, gif->gct, sizeof (rgb_t) * 256));
+		CHECK (back->loop && back->loopcount == 3);
+		CK_SameExtensions (gif, back);
+
+		GIF_FreeGif (back);
+	}
+
+	if (data) {
+		B_FreeBuffer (data);
+	}
+
+	GIF_FreeGif (gif);
+
+	return ok;
+}
+
+/*
+  A decoded GIF encodes back to the very stream it was decoded from.
+*/
+
+GBOOL CK_EncodeAgain (void) {
+	gif_t*    gif;
+	gif_t*    back;
+	buffer_t* first;
+	buffer_t* second;
+
+	if (!CHECK ((gif = CK_MakeEncodeGif ()) != NULL)) {
+		return GFALSE;
+	}
+
+	first  = CK_Encode (gif, 1);
+	second = NULL;
+
+	GIF_FreeGif (gif);
+
+	if (!CHECK (first != NULL) || !CHECK (GIF_ProcessMemory (&back, (const GBYTE*) first->data, first->size))) {
+		goto clean;
+	}
+
+	second = CK_Encode (back, 1);
+
+	GIF_FreeGif (back);
+
+	if (CHECK (second != NULL)) {
+		CHECK (second->size == first->size && !memcmp (second->data, first->data, first->size));
+	}
+
+clean:
+	if (first) {
+		B_FreeBuffer (first);
+	}
+
+	if (second) {
+		B_FreeBuffer (second);
+	}
+
+	return GTRUE;
+}
+
+/*
+  Reads a buffer as a stream that cannot move, like a pipe.
+*/
+
+typedef struct reader_s {
+	const buffer_t*                    data;
+	unsigned long                      position;
+} reader_t;
+
+GBOOL CK_ReadOnly (void* user, void* ptr, unsigned long count) {
+	reader_t* r;
+
+	r = (reader_t*) user;
+
+	if (count > r->data->size - r->position) {
+		return GFALSE;
+	}
+
+	memcpy (ptr, (const GBYTE*) r->data->data + r->position, count);
+	r->position += count;
+
+	return GTRUE;
+}
+
+/*
+  A context decodes its stream again from the start however the last call
+  left it: decoding twice, scanning first, or decoding scaled first. A stream
+  that cannot move back fails the second time as used up, not truncated.
+*/
+
+GBOOL CK_DecodeAgain (void) {
+	gif_t*     gif;
+	gif_t*     first;
+	gif_t*     second;
+	buffer_t*  data;
+	context_t* ctx;
+	reader_t   reader;
+
+	if (!CHECK ((gif = CK_MakeEncodeGif ()) != NULL)) {
+		return GFALSE;
+	}
+
+	data = CK_Encode (gif, 1);
+	ctx  = NULL;
+
+	if (!CHECK (data != NULL) || !CHECK ((ctx = GIF_NewMemoryContext ((const GBYTE*) data->data, data->size)) != NULL)) {
+		goto clean;
+	}
+
+	if (CHECK (GIF_Decode (ctx, &first))) {
+		if (CHECK (GIF_Decode (ctx, &second))) {
+			CK_SameImages (first, second);
+			GIF_FreeGif (second);
+		}
+
+		GIF_FreeGif (first);
+	}
+
+	if (CHECK (GIF_Scan (ctx, &first))) {
+		CHECK (first->imagecount == gif->imagecount);
+		GIF_FreeGif (first);
+
+		if (CHECK (GIF_Decode (ctx, &second))) {
+			CK_SameImages (gif, second);
+			GIF_FreeGif (second);
+		}
+	}
+
+	if (CHECK (GIF_SetScale (ctx, 160, 120)) && CHECK (GIF_Decode (ctx, &first))) {
+		CHECK (first->screenwidth == 160 && first->screenheight == 120);
+		GIF_FreeGif (first);
+
+		if (CHECK (GIF_SetScale (ctx, 0, 0)) && CHECK (GIF_Decode (ctx, &second))) {
+			CK_SameImages (gif, second);
+			GIF_FreeGif (second);
+		}
+	}
+
+	CHECK (GIF_GetError (ctx) == ERRORNONE);
+	GIF_FreeContext (ctx);
+
+	reader.data     = data;
+	reader.position = 0;
+
+	if (!CHECK ((ctx = GIF_NewContext (&CK_ReadOnly, NULL, &reader)) != NULL)) {
+		goto clean;
+	}
+
+	if (CHECK (GIF_Decode (ctx, &first))) {
+		CK_SameImages (gif, first);
+		GIF_FreeGif (first);
+	}
+
+	CHECK (!GIF_Decode (ctx, &second) && GIF_GetError (ctx) == ERRORFAILED);
+	CHECK (!GIF_Scan (ctx, &second) && GIF_GetError (ctx) == ERRORFAILED);
+
+clean:
+	if (ctx) {
+		GIF_FreeContext (ctx);
+	}
+
+	if (data) {
+		B_FreeBuffer (data);
+	}
+
+	GIF_FreeGif (gif);
+
+	return GTRUE;
+}
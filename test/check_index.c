@@ -0,0 +1,172 @@
+#include <stdlib.h>
+#include <string.h>
+#include "check.h"
+#include "index.h"
+
+/*
+  Renders every frame of "gif" in order and returns the canvases, one after
+  the other, or NULL.
+*/
+
+GBYTE* CK_RenderAll (gif_t* gif) {
+	canvas_t*     canvas;
+	image_t*      i;
+	GBYTE*        frames;
+	unsigned long size, k;
+
+	size = (unsigned long) gif->screenwidth * gif->screenheight * 4;
+
+	if ((frames = (GBYTE*) malloc (size * gif->imagecount)) == NULL) {
+		return NULL;
+	}
+
+	if ((canvas = CV_NewCanvas (gif)) == NULL) {
+		free (frames);
+		return NULL;
+	}
+
+	for (i = gif->images, k = 0; i; i = i->next, k++) {
+		if (!CV_DrawImage (canvas, gif, i)) {
+			free (frames);
+			frames = NULL;
+			break;
+		}
+
+		memcpy (frames + k * size, canvas->pixels, size);
+	}
+
+	CV_FreeCanvas (canvas);
+
+	return frames;
+}
+
+/*
+  The index of a stream points at its blocks, survives being saved and loaded
+  back, turns down damaged blobs, and renders any frame, in any order, as
+  drawing all the frames up to it does.
+*/
+
+GBOOL CK_IndexFrames (void) {
+	gif_t*         gif;
+	buffer_t*      data;
+	buffer_t*      blob;
+	context_t*     ctx;
+	frameindex_t*  index;
+	frameindex_t*  loaded;
+	canvas_t*      canvas;
+	image_t*       i;
+	GBYTE*         frames;
+	frameentry_t*  f;
+	frameentry_t*  g;
+	unsigned long  k, n, size, keyframes;
+
+	gif    = NULL;
+	data   = NULL;
+	blob   = NULL;
+	ctx    = NULL;
+	index  = NULL;
+	loaded = NULL;
+	canvas = NULL;
+	frames = NULL;
+
+	if (!CHECK ((gif = CK_NewAnimation (30)) != NULL) || !CHECK ((data = CK_Encode (gif, 1)) != NULL)) {
+		goto clean;
+	}
+
+	GIF_FreeGif (gif);
+	gif = NULL;
+
+	if (!CHECK (GIF_ProcessMemory (&gif, (const GBYTE*) data->data, data->size)) || !CHECK ((frames = CK_RenderAll (gif)) != NULL)) {
+		goto clean;
+	}
+
+	if (!CHECK ((ctx = GIF_NewMemoryContext ((const GBYTE*) data->data, data->size)) != NULL) || !CHECK ((index = FI_BuildIndex (ctx)) != NULL)) {
+		goto clean;
+	}
+
+	if (!CHECK (index->count == gif->imagecount)) {
+		goto clean;
+	}
+
+	for (i = gif->images, f = index->frames, keyframes = 0; i; i = i->next, f++) {
+		CHECK (f->gceoffset == i->gceoffset && f->descoffset == i->descoffset && f->dataoffset == i->dataoffset);
+		CHECK (f->offset == (i->gceoffset ? i->gceoffset : i->descoffset));
+		CHECK ((f->lctoffset != 0) == (i->lct != NULL));
+
+		if (f->keyframe) {
+			keyframes++;
+		}
+	}
+
+	CHECK (index->frames[0].keyframe && keyframes > 1 && keyframes < index->count);
+
+	// Saved and loaded back.
+
+	if (!CHECK ((blob = FI_SaveIndex (index)) != NULL) || !CHECK ((loaded = FI_LoadIndex ((const GBYTE*) blob->data, blob->size)) != NULL)) {
+		goto clean;
+	}
+
+	if (CHECK (loaded->count == index->count)) {
+		for (k = 0; k < index->count; k++) {
+			f = index->frames + k;
+			g = loaded->frames + k;
+
+			CHECK (f->offset == g->offset && f->gceoffset == g->gceoffset && f->descoffset == g->descoffset);
+			CHECK (f->lctoffset == g->lctoffset && f->dataoffset == g->dataoffset && f->keyframe == g->keyframe);
+		}
+	}
+
+	for (n = 0; n < blob->size; n++) {
+		CHECK (FI_LoadIndex ((const GBYTE*) blob->data, n) == NULL);
+	}
+
+	((GBYTE*) blob->data)[0] ^= 0xFF;
+	CHECK (FI_LoadIndex ((const GBYTE*) blob->data, blob->size) == NULL);
+
+	// Frames rendered forwards, then backwards onto the same canvas.
+
+	size = (unsigned long) gif->screenwidth * gif->screenheight * 4;
+
+	for (k = 0; k < 2 * loaded->count; k++) {
+		n = k < loaded->count ? k : 2 * loaded->count - 1 - k;
+
+		if (CHECK (FI_DecodeFrame (ctx, loaded, n, &canvas))) {
+			CHECK (!memcmp (canvas->pixels, frames + n * size, size));
+		}
+	}
+
+	CHECK (!FI_DecodeFrame (ctx, loaded, loaded->count, &canvas));
+
+clean:
+	if (canvas) {
+		CV_FreeCanvas (canvas);
+	}
+
+	if (loaded) {
+		FI_FreeIndex (loaded);
+	}
+
+	if (index) {
+		FI_FreeIndex (index);
+	}
+
+	if (ctx) {
+		GIF_FreeContext (ctx);
+	}
+
+	if (blob) {
+		B_FreeBuffer (blob);
+	}
+
+	if (data) {
+		B_FreeBuffer (data);
+	}
+
+	if (gif) {
+		GIF_FreeGif (gif);
+	}
+
+	free (frames);
+
+	return GTRUE;
+}
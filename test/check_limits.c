@@ -0,0 +1,272 @@
+#include <stdlib.h>
+#include <string.h>
+#include "check.h"
+
+#define MODES                          3                   // Decoding on one thread, on several, and pushed.
+
+/*
+  Decodes "data" within "limits" in mode "mode". Returns the GIF, or NULL
+  with the error of the decode in "error".
+*/
+
+gif_t* CK_DecodeLimited (const buffer_t* data, const limits_t* limits, unsigned int mode, unsigned int* error) {
+	context_t*    ctx;
+	gif_t*        gif;
+	unsigned long offset, n;
+
+	ctx = mode < 2 ? GIF_NewMemoryContext ((const GBYTE*) data->data, data->size) : GIF_NewPushContext (NULL, NULL);
+
+	if (ctx == NULL) {
+		return NULL;
+	}
+
+	GIF_SetLimits (ctx, limits);
+	GIF_SetThreads (ctx, mode == 1 ? 4 : 1);
+
+	gif = NULL;
+
+	if (mode < 2) {
+		if (!GIF_Decode (ctx, &gif)) {
+			gif = NULL;
+		}
+	} else {
+		for (offset = 0; offset < data->size; offset += n) {
+			n = data->size - offset < 777 ? data->size - offset : 777;
+
+			if (!GIF_Push (ctx, (const GBYTE*) data->data + offset, n)) {
+				goto clean;
+			}
+		}
+
+		if (!GIF_EndPush (ctx, &gif)) {
+			gif = NULL;
+		}
+	}
+
+clean:
+	*error = GIF_GetError (ctx);
+
+	GIF_FreeContext (ctx);
+
+	return gif;
+}
+
+/*
+  Tells whether "data" decodes in every mode within "limits" to the images of
+  "full".
+*/
+
+GBOOL CK_Within (const buffer_t* data, gif_t* full, const limits_t* limits) {
+	gif_t*       gif;
+	unsigned int mode, error;
+	GBOOL        ok;
+
+	for (mode = 0, ok = GTRUE; mode < MODES && ok; mode++) {
+		ok = CHECK ((gif = CK_DecodeLimited (data, limits, mode, &error)) != NULL) && CHECK (error == ERRORNONE) && CK_SameImages (full, gif);
+
+		if (gif) {
+			GIF_FreeGif (gif);
+		}
+	}
+
+	return ok;
+}
+
+/*
+  Tells whether "data" fails in every mode with "expected" beyond "limits".
+*/
+
+GBOOL CK_Beyond (const buffer_t* data, const limits_t* limits, unsigned int expected) {
+	gif_t*       gif;
+	unsigned int mode, error;
+	GBOOL        ok;
+
+	for (mode = 0, ok = GTRUE; mode < MODES && ok; mode++) {
+		ok = CHECK ((gif = CK_DecodeLimited (data, limits, mode, &error)) == NULL) && CHECK (error == expected);
+
+		if (gif) {
+			GIF_FreeGif (gif);
+		}
+	}
+
+	return ok;
+}
+
+/*
+  Each limit passes a stream exactly at it and turns it down one short, with
+  the error of its own, whether decoded on one thread, on several or pushed.
+  The pixels of an image larger than the screen count too, and scanning
+  decodes no bytes.
+*/
+
+GBOOL CK_DecodeLimits (void) {
+	gif_t*             gif;
+	gif_t*             full;
+	image_t*           i;
+	buffer_t*          data;
+	comment_t*         c;
+	app_t*             a;
+	text_t*            t;
+	context_t*         ctx;
+	limits_t           limits;
+	unsigned long long bytes;
+	unsigned long      pixels;
+	unsigned int       error;
+
+	if (!CHECK ((gif = CK_MakeEncodeGif ()) != NULL)) {
+		return GFALSE;
+	}
+
+	data = CK_Encode (gif, 1);
+	full = NULL;
+
+	GIF_FreeGif (gif);
+
+	if (!CHECK (data != NULL) || !CHECK (GIF_ProcessMemory (&full, (const GBYTE*) data->data, data->size))) {
+		goto clean;
+	}
+
+	memset (&limits, 0, sizeof (limits_t));
+
+	// Frames.
+
+	limits.frames = full->imagecount;
+	CK_Within (data, full, &limits);
+	limits.frames--;
+	CK_Beyond (data, &limits, ERRORLIMITFRAMES);
+	limits.frames = 0;
+
+	// Pixels, of the screen here.
+
+	for (i = full->images, pixels = 0, bytes = 0; i; i = i->next) {
+		pixels = (unsigned long) i->width * i->height > pixels ? (unsigned long) i->width * i->height : pixels;
+		bytes += (unsigned long) i->width * i->height;
+	}
+
+	CHECK (pixels <= (unsigned long) full->screenwidth * full->screenheight);
+
+	limits.pixels = (unsigned long) full->screenwidth * full->screenheight;
+	CK_Within (data, full, &limits);
+	limits.pixels--;
+	CK_Beyond (data, &limits, ERRORLIMITPIXELS);
+	limits.pixels = 0;
+
+	// Bytes decoded, all the images together.
+
+	limits.bytes = bytes;
+	CK_Within (data, full, &limits);
+	limits.bytes--;
+	CK_Beyond (data, &limits, ERRORLIMITBYTES);
+
+	// Scanning decodes nothing.
+
+	limits.bytes = 1;
+
+	if (CHECK ((ctx = GIF_NewMemoryContext ((const GBYTE*) data->data, data->size)) != NULL)) {
+		GIF_SetLimits (ctx, &limits);
+
+		if (CHECK (GIF_Scan (ctx, &gif))) {
+			CHECK (gif->imagecount == full->imagecount);
+			GIF_FreeGif (gif);
+		}
+
+		CHECK (GIF_GetError (ctx) == ERRORNONE);
+		GIF_FreeContext (ctx);
+	}
+
+	limits.bytes = 0;
+
+	// Extension data kept, looping application included.
+
+	for (c = full->comments; c; c = c->next) {
+		limits.extension += strlen (c->comment);
+	}
+
+	for (a = full->apps; a; a = a->next) {
+		limits.extension += a->size;
+	}
+
+	for (t = full->texts; t; t = t->next) {
+		limits.extension += strlen (t->text);
+	}
+
+	CK_Within (data, full, &limits);
+	limits.extension--;
+	CK_Beyond (data, &limits, ERRORLIMITEXTENSION);
+	limits.extension = 0;
+
+	GIF_FreeGif (full);
+	B_FreeBuffer (data);
+
+	full = NULL;
+	data = NULL;
+
+	// An image larger than its screen.
+
+	if (!CHECK ((gif = CK_NewGif (40, 30)) != NULL)) {
+		goto clean;
+	}
+
+	CHECK (CK_AddImage (gif, 0, 0, 20, 10, 256) != NULL && CK_AddImage (gif, 5, 5, 60, 50, 256) != NULL);
+
+	data = CK_Encode (gif, 1);
+
+	GIF_FreeGif (gif);
+
+	if (!CHECK (data != NULL) || !CHECK (GIF_ProcessMemory (&full, (const GBYTE*) data->data, data->size))) {
+		goto clean;
+	}
+
+	limits.pixels = 60 * 50;
+	CK_Within (data, full, &limits);
+	limits.pixels--;
+	CK_Beyond (data, &limits, ERRORLIMITPIXELS);
+	limits.pixels = 0;
+
+	GIF_FreeGif (full);
+	B_FreeBuffer (data);
+
+	full = NULL;
+	data = NULL;
+
+	// Time, on an animation taking far longer than a millisecond to decode.
+
+	if (!CHECK ((gif = CK_NewAnimation (300)) != NULL)) {
+		goto clean;
+	}
+
+	data = CK_Encode (gif, 4);
+
+	GIF_FreeGif (gif);
+
+	if (!CHECK (data != NULL)) {
+		goto clean;
+	}
+
+	limits.milliseconds = 1;
+
+	CHECK ((gif = CK_DecodeLimited (data, &limits, 0, &error)) == NULL && error == ERRORLIMITTIME);
+
+	if (gif) {
+		GIF_FreeGif (gif);
+	}
+
+	limits.milliseconds = 100000;
+
+	if (CHECK ((gif = CK_DecodeLimited (data, &limits, 1, &error)) != NULL)) {
+		GIF_FreeGif (gif);
+	}
+
+	CHECK (error == ERRORNONE);
+
+clean:
+	if (full) {
+		GIF_FreeGif (full);
+	}
+
+	if (data) {
+		B_FreeBuffer (data);
+	}
+
+	return GTRUE;
+}
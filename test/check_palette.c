@@ -0,0 +1,196 @@
+#include <string.h>
+#include "check.h"
+#include "palette.h"
+
+#define MAXCOUNT                       1100
+#define GUARD                          64
+
+typedef void                           (*PK)(const unsigned int*, const GBYTE*, GBYTE*, unsigned long);
+
+// Kernels of src/palette.c, which only hands them out through P_ExpandRow()
+// and P_DrawRow().
+
+	void                               P_Expand4 (const unsigned int* table, const GBYTE* indexes, GBYTE* out, unsigned long count);
+	void                               P_Expand3 (const unsigned int* table, const GBYTE* indexes, GBYTE* out, unsigned long count);
+	void                               P_Draw4 (const unsigned int* table, const GBYTE* indexes, GBYTE* out, unsigned long count);
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PALETTESIMD
+
+	void                               P_Expand4AVX2 (const unsigned int* table, const GBYTE* indexes, GBYTE* out, unsigned long count);
+	void                               P_Draw4AVX2 (const unsigned int* table, const GBYTE* indexes, GBYTE* out, unsigned long count);
+	void                               P_Expand3AVX2 (const unsigned int* table, const GBYTE* indexes, GBYTE* out, unsigned long count);
+	void                               P_Expand3SSSE3 (const unsigned int* table, const GBYTE* indexes, GBYTE* out, unsigned long count);
+#endif
+
+typedef struct kernelpair_s {
+	PK                                 kernel;
+	PK                                 scalar;             // Plain C kernel computing the same.
+	unsigned int                       bytes;              // Bytes per pixel.
+	GBOOL                              supported;          // The processor runs "kernel".
+} kernelpair_t;
+
+/*
+  Fills "colors" with random colors and "table" with them in "format", with a
+  random number of entries and transparent index. Returns the entries.
+*/
+
+UNSIGNED CK_RandomTable (unsigned int* table, rgb_t* colors, GBYTE format, GBOOL* transparent, GBYTE* trnspindex) {
+	UNSIGNED      items;
+	unsigned long k;
+
+	items = (UNSIGNED) (1 + CK_Random () % 256);
+
+	for (k = 0; k < items; k++) {
+		colors[k].red   = (GBYTE) CK_Random ();
+		colors[k].green = (GBYTE) CK_Random ();
+		colors[k].blue  = (GBYTE) CK_Random ();
+	}
+
+	*transparent = CK_Random () % 2 ? GTRUE : GFALSE;
+	*trnspindex  = (GBYTE) CK_Random ();
+
+	P_MakeTable (table, colors, items, format, *transparent, *trnspindex);
+
+	return items;
+}
+
+void CK_RandomBytes (GBYTE* p, unsigned long count) {
+	unsigned long k;
+
+	for (k = 0; k < count; k++) {
+		p[k] = (GBYTE) CK_Random ();
+	}
+}
+
+/*
+  Every SIMD kernel the processor runs writes what its scalar kernel does, for
+  any number of pixels, tails shorter than a vector included, at any
+  alignment, and nothing past the pixels.
+*/
+
+GBOOL CK_PaletteKernels (void) {
+	kernelpair_t  pairs[4];
+	unsigned int  table[256];
+	rgb_t         colors[256];
+	GBYTE         indexes[MAXCOUNT + 8];
+	GBYTE         out[(MAXCOUNT + 8) * 4 + GUARD];
+	GBYTE         expected[(MAXCOUNT + 8) * 4 + GUARD];
+	unsigned long n, k, round, count, shift, size;
+	GBOOL         transparent;
+	GBYTE         trnspindex;
+
+	n = 0;
+
+#ifdef PALETTESIMD
+	pairs[n].kernel      = &P_Expand4AVX2;
+	pairs[n].scalar      = &P_Expand4;
+	pairs[n].bytes       = 4;
+	pairs[n++].supported = __builtin_cpu_supports ("avx2") ? GTRUE : GFALSE;
+
+	pairs[n].kernel      = &P_Draw4AVX2;
+	pairs[n].scalar      = &P_Draw4;
+	pairs[n].bytes       = 4;
+	pairs[n++].supported = __builtin_cpu_supports ("avx2") ? GTRUE : GFALSE;
+
+	pairs[n].kernel      = &P_Expand3AVX2;
+	pairs[n].scalar      = &P_Expand3;
+	pairs[n].bytes       = 3;
+	pairs[n++].supported = __builtin_cpu_supports ("avx2") ? GTRUE : GFALSE;
+
+	pairs[n].kernel      = &P_Expand3SSSE3;
+	pairs[n].scalar      = &P_Expand3;
+	pairs[n].bytes       = 3;
+	pairs[n++].supported = __builtin_cpu_supports ("ssse3") ? GTRUE : GFALSE;
+#endif
+
+	for (k = 0; k < n; k++) {
+		if (!pairs[k].supported) {
+			continue;
+		}
+
+		// Every count up to some vectors past the widest, then long rows.
+
+		for (round = 0; round < 300; round++) {
+			count = round < 200 ? round % 100 : MAXCOUNT - CK_Random () % 100;
+			shift = round % 8;
+			size  = count * pairs[k].bytes + GUARD;
+
+			CK_RandomTable (table, colors, pairs[k].bytes == 4 ? PIXELRGBA : PIXELRGB, &transparent, &trnspindex);
+			CK_RandomBytes (indexes + shift, count);
+			CK_RandomBytes (out + shift, size);
+			memcpy (expected + shift, out + shift, size);
+
+			pairs[k].scalar (table, indexes + shift, expected + shift, count);
+			pairs[k].kernel (table, indexes + shift, out + shift, count);
+
+			if (!CHECK (!memcmp (out + shift, expected + shift, size))) {
+				break;
+			}
+		}
+	}
+
+	return GTRUE;
+}
+
+/*
+  Rows expanded or drawn through the kernels picked for the processor hold
+  the colors of the table in every format, with transparent pixels skipped
+  when drawing and indexes past the table black.
+*/
+
+GBOOL CK_PaletteRows (void) {
+	static const GBYTE formats[] = {PIXELRGBA, PIXELBGRA, PIXELRGB, PIXELBGR};
+	unsigned int       table[256];
+	rgb_t              colors[256];
+	GBYTE              indexes[MAXCOUNT];
+	GBYTE              out[MAXCOUNT * 4 + GUARD];
+	GBYTE              drawn[MAXCOUNT * 4 + GUARD];
+	GBYTE              background[MAXCOUNT * 4 + GUARD];
+	GBYTE              expected[4];
+	GBYTE*             p;
+	GBYTE*             q;
+	unsigned long      f, round, count, k, bytes;
+	UNSIGNED           items;
+	GBOOL              transparent, ok;
+	GBYTE              trnspindex, c;
+
+	for (f = 0; f < sizeof (formats) / sizeof (formats[0]); f++) {
+		bytes = formats[f] == PIXELRGB || formats[f] == PIXELBGR ? 3 : 4;
+
+		for (round = 0, ok = GTRUE; round < 100 && ok; round++) {
+			count = round < 50 ? round : 1 + CK_Random () % MAXCOUNT;
+			items = CK_RandomTable (table, colors, formats[f], &transparent, &trnspindex);
+
+			CK_RandomBytes (indexes, count);
+			CK_RandomBytes (background, count * bytes + GUARD);
+			memcpy (out, background, count * bytes + GUARD);
+			memcpy (drawn, background, count * bytes + GUARD);
+
+			P_ExpandRow (table, indexes, out, count, formats[f]);
+			P_DrawRow (table, indexes, drawn, count, formats[f]);
+
+			for (k = 0, p = out, q = drawn; k < count && ok; k++, p += bytes, q += bytes) {
+				c = indexes[k];
+
+				expected[0] = c >= items ? 0 : (formats[f] == PIXELBGRA || formats[f] == PIXELBGR ? colors[c].blue : colors[c].red);
+				expected[1] = c >= items ? 0 : colors[c].green;
+				expected[2] = c >= items ? 0 : (formats[f] == PIXELBGRA || formats[f] == PIXELBGR ? colors[c].red : colors[c].blue);
+				expected[3] = transparent && c == trnspindex ? 0x00 : 0xFF;
+
+				ok = CHECK (!memcmp (p, expected, bytes));
+
+				if (transparent && c == trnspindex) {
+					ok = ok && CHECK (!memcmp (q, background + k * bytes, bytes));
+				} else {
+					ok = ok && CHECK (!memcmp (q, expected, bytes));
+				}
+			}
+
+			ok = ok && CHECK (!memcmp (out + count * bytes, background + count * bytes, GUARD));
+			ok = ok && CHECK (!memcmp (drawn + count * bytes, background + count * bytes, GUARD));
+		}
+	}
+
+	return GTRUE;
+}
@@ -0,0 +1,103 @@
+#include <stdlib.h>
+#include "check.h"
+
+/*
+  Image function counting the images completed.
+*/
+
+GBOOL CK_CountImages (void* user, gif_t* gif, image_t* image, GBOOL complete) {
+	if (complete) {
+		(*(unsigned long*) user)++;
+	}
+
+	return GTRUE;
+}
+
+/*
+  Pushes "size" bytes of "data" in chunks of "chunk" bytes, or of random sizes
+  up to 1000 when "chunk" is 0. Returns the GIF, or NULL with the error in
+  "error".
+*/
+
+gif_t* CK_PushChunks (const GBYTE* data, unsigned long size, unsigned long chunk, unsigned long* complete, unsigned int* error) {
+	context_t*    ctx;
+	gif_t*        gif;
+	unsigned long offset, n;
+
+	if ((ctx = GIF_NewPushContext (&CK_CountImages, complete)) == NULL) {
+		return NULL;
+	}
+
+	for (offset = 0, gif = NULL; offset < size; offset += n) {
+		n = chunk > 0 ? chunk : 1 + CK_Random () % 1000;
+
+		if (n > size - offset) {
+			n = size - offset;
+		}
+
+		if (!GIF_Push (ctx, data + offset, n)) {
+			goto clean;
+		}
+	}
+
+	if (!GIF_EndPush (ctx, &gif)) {
+		gif = NULL;
+	}
+
+clean:
+	*error = GIF_GetError (ctx);
+
+	GIF_FreeContext (ctx);
+
+	return gif;
+}
+
+/*
+  A stream pushed in chunks of any size decodes the same, each image being
+  told complete once, and a stream cut short fails at the end of the push.
+*/
+
+GBOOL CK_PushAnySize (void) {
+	static const unsigned long chunks[] = {1, 2, 3, 7, 255, 256, 4096, 0, 0, 0};
+	gif_t*                     gif;
+	gif_t*                     back;
+	buffer_t*                  data;
+	unsigned long              k, complete;
+	unsigned int               error;
+
+	if (!CHECK ((gif = CK_NewAnimation (25)) != NULL)) {
+		return GFALSE;
+	}
+
+	if (!CHECK ((data = CK_Encode (gif, 1)) != NULL)) {
+		GIF_FreeGif (gif);
+		return GFALSE;
+	}
+
+	for (k = 0; k <= sizeof (chunks) / sizeof (chunks[0]); k++) {
+		complete = 0;
+
+		// The last round pushes the whole stream at once.
+
+		back = CK_PushChunks ((const GBYTE*) data->data, data->size, k < sizeof (chunks) / sizeof (chunks[0]) ? chunks[k] : data->size, &complete, &error);
+
+		if (CHECK (back != NULL && error == ERRORNONE)) {
+			CK_SameImages (gif, back);
+			CHECK (back->loop && complete == gif->imagecount);
+			GIF_FreeGif (back);
+		}
+	}
+
+	back = CK_PushChunks ((const GBYTE*) data->data, data->size - 20, 100, &complete, &error);
+
+	CHECK (back == NULL && error == ERRORTRUNCATED);
+
+	if (back) {
+		GIF_FreeGif (back);
+	}
+
+	B_FreeBuffer (data);
+	GIF_FreeGif (gif);
+
+	return GTRUE;
+}
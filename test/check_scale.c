@@ -0,0 +1,127 @@
+#include <stdlib.h>
+#include "check.h"
+
+/*
+  Tells whether "scaled", decoded to fit "width" by "height" pixels, holds
+  the pixels of "full" nearest to the center of each of its own, and sits
+  where they do.
+*/
+
+GBOOL CK_SameSampled (gif_t* full, gif_t* scaled, UNSIGNED width, UNSIGNED height) {
+	image_t*      i;
+	image_t*      j;
+	unsigned long x, y, sx, sy, n, first;
+	const GBYTE*  p;
+	GBOOL         ok;
+
+	ok = CHECK (scaled->screenwidth == width && scaled->screenheight == height) && CHECK (scaled->imagecount == full->imagecount);
+
+	for (i = full->images, j = scaled->images; i && j && ok; i = i->next, j = j->next) {
+
+		// The columns and rows whose centers fall on the image.
+
+		for (x = 0, n = 0, first = 0; x < width; x++) {
+			sx = (2 * x + 1) * full->screenwidth / (2 * width);
+
+			if (sx >= i->left && sx < (unsigned long) i->left + i->width && n++ == 0) {
+				first = x;
+			}
+		}
+
+		ok = CHECK (j->width == n && (n == 0 || j->left == first));
+
+		for (y = 0, n = 0, first = 0; y < height; y++) {
+			sy = (2 * y + 1) * full->screenheight / (2 * height);
+
+			if (sy >= i->top && sy < (unsigned long) i->top + i->height && n++ == 0) {
+				first = y;
+			}
+		}
+
+		ok = ok && CHECK (j->height == n && (n == 0 || j->top == first));
+		ok = ok && CHECK (j->interlaced == i->interlaced && j->transparent == i->transparent && j->disposal == i->disposal);
+		ok = ok && CHECK (j->indexes && j->indexes->size == (unsigned long) j->width * j->height);
+
+		for (y = 0; y < j->height && ok; y++) {
+			sy = (2 * (j->top + y) + 1) * full->screenheight / (2 * height) - i->top;
+			p  = (const GBYTE*) j->indexes->data + y * j->width;
+
+			for (x = 0; x < j->width && ok; x++) {
+				sx = (2 * (j->left + x) + 1) * full->screenwidth / (2 * width) - i->left;
+				ok = CHECK (p[x] == ((const GBYTE*) i->indexes->data)[sy * i->width + sx]);
+			}
+		}
+	}
+
+	return ok && CHECK (i == NULL && j == NULL);
+}
+
+/*
+  Images decoded scaled, interlaced ones and ones at any offset included,
+  are the nearest sampling of the full decode, shrunk or enlarged, with any
+  number of threads. A size of 0 decodes at full size again.
+*/
+
+GBOOL CK_ScaleImages (void) {
+	static const UNSIGNED sizes[][2] = {{80, 60}, {37, 91}, {1, 1}, {160, 120}, {333, 250}};
+	gif_t*                gif;
+	gif_t*                full;
+	gif_t*                scaled;
+	buffer_t*             data;
+	context_t*            ctx;
+	unsigned long         k;
+	unsigned int          threads;
+
+	if (!CHECK ((gif = CK_NewAnimation (30)) != NULL)) {
+		return GFALSE;
+	}
+
+	data = CK_Encode (gif, 1);
+	full = NULL;
+	ctx  = NULL;
+
+	GIF_FreeGif (gif);
+
+	if (!CHECK (data != NULL) || !CHECK (GIF_ProcessMemory (&full, (const GBYTE*) data->data, data->size))) {
+		goto clean;
+	}
+
+	if (!CHECK ((ctx = GIF_NewMemoryContext ((const GBYTE*) data->data, data->size)) != NULL)) {
+		goto clean;
+	}
+
+	CHECK (!GIF_SetScale (ctx, 80, 0) && !GIF_SetScale (ctx, 0, 60));
+
+	for (threads = 1; threads <= 4; threads += 3) {
+		GIF_SetThreads (ctx, threads);
+
+		for (k = 0; k < sizeof (sizes) / sizeof (sizes[0]); k++) {
+			if (CHECK (GIF_SetScale (ctx, sizes[k][0], sizes[k][1])) && CHECK (GIF_Decode (ctx, &scaled))) {
+				CK_SameSampled (full, scaled, sizes[k][0], sizes[k][1]);
+				GIF_FreeGif (scaled);
+			}
+
+			CHECK (GIF_GetError (ctx) == ERRORNONE);
+		}
+
+		if (CHECK (GIF_SetScale (ctx, 0, 0)) && CHECK (GIF_Decode (ctx, &scaled))) {
+			CK_SameImages (full, scaled);
+			GIF_FreeGif (scaled);
+		}
+	}
+
+clean:
+	if (ctx) {
+		GIF_FreeContext (ctx);
+	}
+
+	if (full) {
+		GIF_FreeGif (full);
+	}
+
+	if (data) {
+		B_FreeBuffer (data);
+	}
+
+	return GTRUE;
+}
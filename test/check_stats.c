@@ -0,0 +1,232 @@
+#include <stdlib.h>
+#include <string.h>
+#include "check.h"
+
+// Stream over a buffer counting what is asked of it.
+
+typedef struct counted_s {
+	const buffer_t*                    data;
+	unsigned long                      position;
+	unsigned long                      reads;
+	unsigned long                      moves;
+	unsigned long long                 bytesread;
+	unsigned long long                 bytesskipped;       // Bytes moved over forward.
+} counted_t;
+
+GBOOL CK_CountedRead (void* user, void* ptr, unsigned long count) {
+	counted_t* c;
+
+	c = (counted_t*) user;
+	c->reads++;
+
+	if (count > c->data->size - c->position) {
+		return GFALSE;
+	}
+
+	memcpy (ptr, (const GBYTE*) c->data->data + c->position, count);
+
+	c->position  += count;
+	c->bytesread += count;
+
+	return GTRUE;
+}
+
+GBOOL CK_CountedMove (void* user, long offset) {
+	counted_t* c;
+
+	c = (counted_t*) user;
+	c->moves++;
+
+	if (offset < 0 ? (unsigned long) -offset > c->position : (unsigned long) offset > c->data->size - c->position) {
+		return GFALSE;
+	}
+
+	c->position += offset;
+
+	if (offset > 0) {
+		c->bytesskipped += offset;
+	}
+
+	return GTRUE;
+}
+
+/*
+  Starts counting over, wherever the stream is.
+*/
+
+void CK_CountAgain (counted_t* c) {
+	c->reads        = 0;
+	c->moves        = 0;
+	c->bytesread    = 0;
+	c->bytesskipped = 0;
+}
+
+/*
+  Tells whether the counters of "stats" fit a decode of the images of "full":
+  at least one code per string up to the longest, at most one per index besides
+  the clear codes and ends of information, a clear code starting every image,
+  and the times adding up.
+*/
+
+GBOOL CK_SaneStats (const stats_t* stats, gif_t* full) {
+	image_t*           i;
+	unsigned long long pixels;
+
+	for (i = full->images, pixels = 0; i; i = i->next) {
+		pixels += (unsigned long) i->width * i->height;
+	}
+
+	return CHECK (stats->codes > 0 && stats->maxstring > 0 && stats->codes * stats->maxstring >= pixels)
+		&& CHECK (stats->codes <= pixels + stats->clears + full->imagecount)
+		&& CHECK (stats->clears >= full->imagecount && stats->flushes <= stats->clears)
+		&& CHECK (stats->allocations > full->imagecount)
+		&& CHECK (stats->totaltime > 0 && stats->readtime <= stats->totaltime);
+}
+
+/*
+  Statistics count what each decode asked of the stream and did with it, read
+  or pushed, decoded on one thread or several, and start over with each
+  decode but add up over the pushes. Without GIF_STATS there are none.
+*/
+
+GBOOL CK_DecodeStats (void) {
+	gif_t*        gif;
+	gif_t*        full;
+	buffer_t*     data;
+	context_t*    ctx;
+	counted_t     counted;
+	stats_t       stats;
+#ifdef GIF_STATS
+	stats_t       first;
+	unsigned long offset, n;
+#endif
+
+	if (!CHECK ((gif = CK_NewAnimation (20)) != NULL)) {
+		return GFALSE;
+	}
+
+	data = CK_Encode (gif, 1);
+	full = NULL;
+	ctx  = NULL;
+
+	GIF_FreeGif (gif);
+
+	if (!CHECK (data != NULL) || !CHECK (GIF_ProcessMemory (&full, (const GBYTE*) data->data, data->size))) {
+		goto clean;
+	}
+
+	memset (&counted, 0, sizeof (counted_t));
+	counted.data = data;
+
+	if (!CHECK ((ctx = GIF_NewContext (&CK_CountedRead, &CK_CountedMove, &counted)) != NULL)) {
+		goto clean;
+	}
+
+#ifdef GIF_STATS
+	// Read through the stream functions, every byte once.
+
+	if (CHECK (GIF_Decode (ctx, &gif))) {
+		CK_SameImages (full, gif);
+		GIF_FreeGif (gif);
+	}
+
+	CHECK (GIF_GetStats (ctx, &first));
+	CHECK (first.bytesread == data->size && first.bytesread == counted.bytesread);
+	CHECK (first.reads == counted.reads && first.moves == counted.moves);
+	CK_SaneStats (&first, full);
+	CHECK (first.decodetime > 0 && first.decodetime <= first.totaltime);
+
+	// Decoding again counts the same, not twice as much.
+
+	CK_CountAgain (&counted);
+
+	if (CHECK (GIF_Decode (ctx, &gif))) {
+		GIF_FreeGif (gif);
+	}
+
+	CHECK (GIF_GetStats (ctx, &stats));
+	CHECK (stats.bytesread == first.bytesread && stats.reads == counted.reads && stats.moves == counted.moves);
+	CHECK (stats.codes == first.codes && stats.clears == first.clears && stats.flushes == first.flushes && stats.maxstring == first.maxstring);
+
+	// Scanning moves over the image data and decodes nothing.
+
+	CK_CountAgain (&counted);
+
+	if (CHECK (GIF_Scan (ctx, &gif))) {
+		GIF_FreeGif (gif);
+	}
+
+	CHECK (GIF_GetStats (ctx, &stats));
+	CHECK (stats.bytesread == counted.bytesread && stats.reads == counted.reads && stats.moves == counted.moves);
+	CHECK (stats.bytesread + counted.bytesskipped == data->size && stats.moves > 0);
+	CHECK (stats.codes == 0 && stats.decodetime == 0);
+
+	GIF_FreeContext (ctx);
+
+	// From memory, on several threads: nothing read, the same codes.
+
+	if (!CHECK ((ctx = GIF_NewMemoryContext ((const GBYTE*) data->data, data->size)) != NULL)) {
+		goto clean;
+	}
+
+	GIF_SetThreads (ctx, 4);
+
+	if (CHECK (GIF_Decode (ctx, &gif))) {
+		CK_SameImages (full, gif);
+		GIF_FreeGif (gif);
+	}
+
+	CHECK (GIF_GetStats (ctx, &stats));
+	CHECK (stats.bytesread == 0 && stats.reads == 0 && stats.moves == 0);
+	CHECK (stats.codes == first.codes && stats.clears == first.clears && stats.maxstring == first.maxstring);
+	CHECK (stats.decodetime > 0);
+
+	GIF_FreeContext (ctx);
+
+	// Pushed: every push counts, and the counts add up.
+
+	if (!CHECK ((ctx = GIF_NewPushContext (NULL, NULL)) != NULL)) {
+		goto clean;
+	}
+
+	for (offset = 0, n = 0; offset < data->size; offset += 1000, n++) {
+		if (!CHECK (GIF_Push (ctx, (const GBYTE*) data->data + offset, data->size - offset < 1000 ? data->size - offset : 1000))) {
+			break;
+		}
+	}
+
+	if (CHECK (GIF_EndPush (ctx, &gif))) {
+		CK_SameImages (full, gif);
+		GIF_FreeGif (gif);
+	}
+
+	CHECK (GIF_GetStats (ctx, &stats));
+	CHECK (stats.bytesread == data->size && stats.reads == n);
+	CHECK (stats.codes == first.codes && stats.clears == first.clears && stats.maxstring == first.maxstring);
+	CK_SaneStats (&stats, full);
+#else
+	if (CHECK (GIF_Decode (ctx, &gif))) {
+		GIF_FreeGif (gif);
+	}
+
+	CHECK (!GIF_GetStats (ctx, &stats));
+	CHECK (stats.bytesread == 0 && stats.reads == 0 && stats.moves == 0 && stats.codes == 0 && stats.allocations == 0 && stats.totaltime == 0);
+#endif
+
+	CHECK (GIF_GetError (ctx) == ERRORNONE);
+
+clean:
+	if (ctx) {
+		GIF_FreeContext (ctx);
+	}
+
+	if (full) {
+		GIF_FreeGif (full);
+	}
+
+	if (data) {
+		B_FreeBuffer (data);
+	}
+
+	return GTRUE;
+}
@@ -0,0 +1,174 @@
+#include <stdlib.h>
+#include <string.h>
+#include "check.h"
+
+// What the stream functions were handed so far, against the images of a
+// full decode.
+
+typedef struct streamed_s {
+	image_t*                           expected;           // Full image of the image being streamed.
+	unsigned long                      frames;             // Frames handed over.
+	unsigned long                      rows;               // Rows handed over of the image being streamed.
+	unsigned long                      stop;               // Frame to stop at, 0 for none.
+	GBOOL                              ok;
+} streamed_t;
+
+/*
+  Each row comes once, in the order of the passes of the image, and holds the
+  indexes of the full decode.
+*/
+
+GBOOL CK_StreamRow (void* user, gif_t* gif, image_t* image, UNSIGNED row, const GBYTE* indexes) {
+	streamed_t* s;
+	image_t*    e;
+
+	s = (streamed_t*) user;
+	e = s->expected;
+
+	if (s->ok) {
+		s->ok = CHECK (e != NULL && image->left == e->left && image->top == e->top && image->width == e->width && image->height == e->height)
+			&& CHECK (s->rows < e->height && row == (e->interlaced ? GIF_InterlacedRow (s->rows, e->height) : s->rows))
+			&& CHECK (!memcmp (indexes, (const GBYTE*) e->indexes->data + (unsigned long) row * e->width, e->width));
+	}
+
+	s->rows++;
+
+	return GTRUE;
+}
+
+/*
+  Each frame comes once complete, in stream order, with the indexes and
+  settings of the full decode. Returns GFALSE at frame "stop".
+*/
+
+GBOOL CK_StreamFrame (void* user, gif_t* gif, image_t* image) {
+	streamed_t* s;
+	image_t*    e;
+
+	s = (streamed_t*) user;
+	e = s->expected;
+
+	if (s->ok) {
+		s->ok = CHECK (e != NULL && image->left == e->left && image->top == e->top && image->width == e->width && image->height == e->height)
+			&& CHECK (image->delaytime == e->delaytime && image->disposal == e->disposal && image->transparent == e->transparent && image->lctsize == e->lctsize)
+			&& CHECK (image->indexes && !memcmp (image->indexes->data, e->indexes->data, (unsigned long) e->width * e->height))
+			&& CHECK (gif->imagecount == s->frames + 1 && (s->rows == 0 || s->rows == e->height));
+	}
+
+	s->frames++;
+	s->rows     = 0;
+	s->expected = e ? e->next : NULL;
+
+	return s->stop == 0 || s->frames < s->stop;
+}
+
+/*
+  Rows with no frame function: the next image starts once the rows of the
+  last one are all in. Returns GFALSE on the first row of frame "stop".
+*/
+
+GBOOL CK_StreamRowOnly (void* user, gif_t* gif, image_t* image, UNSIGNED row, const GBYTE* indexes) {
+	streamed_t* s;
+
+	s = (streamed_t*) user;
+
+	if (s->expected && s->rows == s->expected->height) {
+		s->expected = s->expected->next;
+		s->rows     = 0;
+		s->frames++;
+	}
+
+	CK_StreamRow (user, gif, image, row, indexes);
+
+	return s->stop == 0 || s->frames + 1 < s->stop;
+}
+
+/*
+  Streams "data" with "frame" and "row", stopping at frame "stop" if not 0,
+  and checks what was handed over against "full". Returns what GIF_Stream()
+  did.
+*/
+
+GBOOL CK_StreamAll (const buffer_t* data, gif_t* full, FS frame, RS row, unsigned long stop, unsigned int* error) {
+	context_t* ctx;
+	gif_t*     gif;
+	streamed_t s;
+	GBOOL      ok;
+
+	s.expected = full->images;
+	s.frames   = 0;
+	s.rows     = 0;
+	s.stop     = stop;
+	s.ok       = GTRUE;
+
+	if (!CHECK ((ctx = GIF_NewMemoryContext ((const GBYTE*) data->data, data->size)) != NULL)) {
+		return GFALSE;
+	}
+
+	// The stream keeps its global data, and how many images it had.
+
+	if ((ok = GIF_Stream (ctx, &gif, frame, row, &s))) {
+		CHECK (gif->imagecount == full->imagecount && gif->images == NULL);
+		CHECK (gif->screenwidth == full->screenwidth && gif->screenheight == full->screenheight);
+		CHECK (gif->gctsize == full->gctsize && !memcmp (gif->gct, full->gct, sizeof (rgb_t) * full->gctsize));
+		CHECK (gif->loop == full->loop);
+		CHECK (frame == NULL || s.frames == full->imagecount);
+		CHECK (row == NULL || s.expected == NULL || (s.expected->next == NULL && s.rows == s.expected->height));
+
+		GIF_FreeGif (gif);
+	}
+
+	*error = GIF_GetError (ctx);
+
+	GIF_FreeContext (ctx);
+
+	return ok;
+}
+
+/*
+  Streaming hands over the rows and frames of a full decode, one image at a
+  time, whichever functions are given, and stops when either function says
+  so.
+*/
+
+GBOOL CK_StreamImages (void) {
+	gif_t*       gif;
+	gif_t*       full;
+	buffer_t*    data;
+	unsigned int error;
+
+	if (!CHECK ((gif = CK_NewAnimation (40)) != NULL)) {
+		return GFALSE;
+	}
+
+	data = CK_Encode (gif, 1);
+	full = NULL;
+
+	GIF_FreeGif (gif);
+
+	if (!CHECK (data != NULL) || !CHECK (GIF_ProcessMemory (&full, (const GBYTE*) data->data, data->size))) {
+		goto clean;
+	}
+
+	CHECK (CK_StreamAll (data, full, &CK_StreamFrame, &CK_StreamRow, 0, &error) && error == ERRORNONE);
+	CHECK (CK_StreamAll (data, full, &CK_StreamFrame, NULL, 0, &error) && error == ERRORNONE);
+	CHECK (CK_StreamAll (data, full, NULL, &CK_StreamRowOnly, 0, &error) && error == ERRORNONE);
+	CHECK (CK_StreamAll (data, full, NULL, NULL, 0, &error) && error == ERRORNONE);
+
+	// Stopped by the frame function once the fourth image is in, then by the
+	// row function as it starts.
+
+	CHECK (!CK_StreamAll (data, full, &CK_StreamFrame, &CK_StreamRow, 4, &error) && error == ERRORSTOPPED);
+	CHECK (!CK_StreamAll (data, full, NULL, &CK_StreamRowOnly, 4, &error) && error == ERRORSTOPPED);
+
+clean:
+	if (full) {
+		GIF_FreeGif (full);
+	}
+
+	if (data) {
+		B_FreeBuffer (data);
+	}
+
+	return GTRUE;
+}
@@ -0,0 +1,88 @@
+#include <string.h>
+#include "check.h"
+
+/*
+  Images compressed in stripes decode to the same indexes for any number of
+  threads. Stripes do make a different stream, but always the same one for a
+  number of threads; small images are compressed whole.
+*/
+
+GBOOL CK_EncodeStripes (void) {
+	static const unsigned int threads[] = {2, 3, 4, 7, 16};
+	gif_t*                    gif;
+	gif_t*                    back;
+	image_t*                  i;
+	buffer_t*                 single;
+	buffer_t*                 data;
+	buffer_t*                 again;
+	unsigned long             k;
+
+	if (!CHECK ((gif = CK_NewGif (640, 480)) != NULL)) {
+		return GFALSE;
+	}
+
+	if (!CHECK (CK_AddImage (gif, 0, 0, 640, 480, 256) != NULL) || !CHECK ((i = CK_AddImage (gif, 0, 0, 509, 301, 256)) != NULL)) {
+		GIF_FreeGif (gif);
+		return GFALSE;
+	}
+
+	i->interlaced = GTRUE;
+
+	if (!CHECK ((single = CK_Encode (gif, 1)) != NULL)) {
+		GIF_FreeGif (gif);
+		return GFALSE;
+	}
+
+	for (k = 0; k < sizeof (threads) / sizeof (threads[0]); k++) {
+		data  = CK_Encode (gif, threads[k]);
+		again = CK_Encode (gif, threads[k]);
+
+		if (CHECK (data != NULL && again != NULL)) {
+			CHECK (data->size != single->size || memcmp (data->data, single->data, data->size));
+			CHECK (data->size == again->size && !memcmp (data->data, again->data, data->size));
+
+			if (CHECK (GIF_ProcessMemory (&back, (const GBYTE*) data->data, data->size))) {
+				CK_SameImages (gif, back);
+				GIF_FreeGif (back);
+			}
+		}
+
+		if (data) {
+			B_FreeBuffer (data);
+		}
+
+		if (again) {
+			B_FreeBuffer (again);
+		}
+	}
+
+	B_FreeBuffer (single);
+	GIF_FreeGif (gif);
+
+	// A frame too small to be worth splitting comes out as with one thread.
+
+	if (!CHECK ((gif = CK_NewGif (64, 64)) != NULL)) {
+		return GFALSE;
+	}
+
+	if (CHECK (CK_AddImage (gif, 0, 0, 64, 64, 256) != NULL)) {
+		single = CK_Encode (gif, 1);
+		data   = CK_Encode (gif, 8);
+
+		if (CHECK (single != NULL && data != NULL)) {
+			CHECK (data->size == single->size && !memcmp (data->data, single->data, data->size));
+		}
+
+		if (single) {
+			B_FreeBuffer (single);
+		}
+
+		if (data) {
+			B_FreeBuffer (data);
+		}
+	}
+
+	GIF_FreeGif (gif);
+
+	return GTRUE;
+}
@@ -0,0 +1,75 @@
+#include <stdlib.h>
+#include "check.h"
+
+/*
+  Decodes "data" from memory with "threads" threads. Returns the GIF, or NULL
+  with the error of the decode in "error".
+*/
+
+gif_t* CK_DecodeWith (const buffer_t* data, unsigned long size, unsigned int threads, unsigned int* error) {
+	context_t* ctx;
+	gif_t*     gif;
+
+	if ((ctx = GIF_NewMemoryContext ((const GBYTE*) data->data, size)) == NULL) {
+		return NULL;
+	}
+
+	GIF_SetThreads (ctx, threads);
+
+	if (!GIF_Decode (ctx, &gif)) {
+		gif = NULL;
+	}
+
+	*error = GIF_GetError (ctx);
+
+	GIF_FreeContext (ctx);
+
+	return gif;
+}
+
+/*
+  Images decoded by several threads are those decoded by one, whatever the
+  number of threads, and a stream cut short fails the same way.
+*/
+
+GBOOL CK_DecodeThreaded (void) {
+	static const unsigned int threads[] = {1, 2, 3, 8, 64};
+	gif_t*                    gif;
+	gif_t*                    back;
+	buffer_t*                 data;
+	unsigned long             k;
+	unsigned int              error;
+
+	if (!CHECK ((gif = CK_NewAnimation (40)) != NULL)) {
+		return GFALSE;
+	}
+
+	if (!CHECK ((data = CK_Encode (gif, 1)) != NULL)) {
+		GIF_FreeGif (gif);
+		return GFALSE;
+	}
+
+	for (k = 0; k < sizeof (threads) / sizeof (threads[0]); k++) {
+		if (CHECK ((back = CK_DecodeWith (data, data->size, threads[k], &error)) != NULL)) {
+			CK_SameImages (gif, back);
+			GIF_FreeGif (back);
+		}
+	}
+
+	// Cut in the middle of the image data of the last frame.
+
+	for (k = 0; k < sizeof (threads) / sizeof (threads[0]); k++) {
+		back = CK_DecodeWith (data, data->size - 20, threads[k], &error);
+
+		CHECK (back == NULL && error == ERRORTRUNCATED);
+
+		if (back) {
+			GIF_FreeGif (back);
+		}
+	}
+
+	B_FreeBuffer (data);
+	GIF_FreeGif (gif);
+
+	return GTRUE;
+}
@@ -0,0 +1,271 @@
+#include <stdlib.h>
+#include <string.h>
+#include "check.h"
+
+#define MODES                          3                   // Decoding on one thread, on several, and pushed.
+#define TARGET                         5                   // Image damaged, neither interlaced nor transparent.
+
+/*
+  Decodes the first "size" bytes of "data", tolerant or not, in mode "mode".
+  Returns the GIF, or NULL with the error of the decode in "error".
+*/
+
+gif_t* CK_DecodeDamaged (const GBYTE* data, unsigned long size, GBOOL tolerant, unsigned int mode, unsigned int* error) {
+	context_t*    ctx;
+	gif_t*        gif;
+	unsigned long offset, n;
+
+	ctx = mode < 2 ? GIF_NewMemoryContext (data, size) : GIF_NewPushContext (NULL, NULL);
+
+	if (ctx == NULL) {
+		return NULL;
+	}
+
+	GIF_SetTolerant (ctx, tolerant);
+	GIF_SetThreads (ctx, mode == 1 ? 4 : 1);
+
+	gif = NULL;
+
+	if (mode < 2) {
+		if (!GIF_Decode (ctx, &gif)) {
+			gif = NULL;
+		}
+	} else {
+		// A push failing still ends with what was decoded in tolerant mode.
+
+		for (offset = 0; offset < size; offset += n) {
+			n = size - offset < 500 ? size - offset : 500;
+
+			if (!GIF_Push (ctx, data + offset, n)) {
+				break;
+			}
+		}
+
+		if (!GIF_EndPush (ctx, &gif)) {
+			gif = NULL;
+		}
+	}
+
+	*error = GIF_GetError (ctx);
+
+	GIF_FreeContext (ctx);
+
+	return gif;
+}
+
+/*
+  Tells whether the "count" images from "j" on are those from "i" on, none of
+  them damaged.
+*/
+
+GBOOL CK_SameFirst (image_t* i, image_t* j, unsigned long count) {
+	unsigned long k;
+	GBOOL         ok;
+
+	for (k = 0, ok = GTRUE; k < count && ok; i = i->next, j = j->next, k++) {
+		ok = CHECK (i != NULL && j != NULL) && CHECK (!j->damaged && i->width == j->width && i->height == j->height)
+			&& CHECK (j->indexes && !memcmp (i->indexes->data, j->indexes->data, (unsigned long) i->width * i->height));
+	}
+
+	return ok;
+}
+
+/*
+  Tells whether "j", damaged, holds the indexes of "i" up to some point, at
+  least "whole" of them, and 0 past it.
+*/
+
+GBOOL CK_DamagedLike (image_t* i, image_t* j, unsigned long whole) {
+	const GBYTE*  p;
+	const GBYTE*  q;
+	unsigned long k, n;
+
+	if (!CHECK (j->damaged && j->indexes && j->width == i->width && j->height == i->height)) {
+		return GFALSE;
+	}
+
+	p = (const GBYTE*) i->indexes->data;
+	q = (const GBYTE*) j->indexes->data;
+	n = (unsigned long) i->width * i->height;
+
+	for (k = 0; k < n && p[k] == q[k]; k++);
+
+	if (!CHECK (k >= whole)) {
+		return GFALSE;
+	}
+
+	for (; k < n && q[k] == 0; k++);
+
+	return CHECK (k == n);
+}
+
+/*
+  Tells whether "data", "size" bytes, fails with "strict" unless tolerant, and
+  decodes tolerant with "damage" to "count" images, the first "whole" of them
+  those of "full". Returns the GIF decoded in the last mode, or NULL.
+*/
+
+gif_t* CK_Tolerated (const GBYTE* data, unsigned long size, gif_t* full, unsigned int strict, unsigned int damage, unsigned long count, unsigned long whole) {
+	gif_t*       gif;
+	unsigned int mode, error;
+
+	for (mode = 0, gif = NULL; mode < MODES; mode++) {
+		if (gif) {
+			GIF_FreeGif (gif);
+		}
+
+		if (!CHECK ((gif = CK_DecodeDamaged (data, size, GFALSE, mode, &error)) == NULL) || !CHECK (error == strict)) {
+			break;
+		}
+
+		if (!CHECK ((gif = CK_DecodeDamaged (data, size, GTRUE, mode, &error)) != NULL) || !CHECK (error == damage)) {
+			break;
+		}
+
+		if (!CHECK (gif->imagecount == count) || !CK_SameFirst (full->images, gif->images, whole)) {
+			break;
+		}
+	}
+
+	if (mode < MODES && gif) {
+		GIF_FreeGif (gif);
+		gif = NULL;
+	}
+
+	return gif;
+}
+
+/*
+  Streams cut short or damaged fail with what went wrong, and decode in
+  tolerant mode to the images reached, the one hit marked damaged and the
+  error recovered from told, whether decoded on one thread, on several or
+  pushed. A bad code only damages its image. Streams that are no GIF or end
+  before the screen fail all the same.
+*/
+
+GBOOL CK_DecodeTolerant (void) {
+	gif_t*        gif;
+	gif_t*        full;
+	gif_t*        scan;
+	image_t*      t;
+	image_t*      i;
+	image_t*      j;
+	buffer_t*     data;
+	GBYTE*        copy;
+	unsigned long k, size;
+	unsigned int  mode, error;
+
+	if (!CHECK ((gif = CK_NewAnimation (12)) != NULL)) {
+		return GFALSE;
+	}
+
+	data = CK_Encode (gif, 1);
+	full = NULL;
+	scan = NULL;
+	copy = NULL;
+
+	GIF_FreeGif (gif);
+
+	if (!CHECK (data != NULL) || !CHECK (GIF_ProcessMemory (&full, (const GBYTE*) data->data, data->size)) || !CHECK (GIF_ScanMemory (&scan, (const GBYTE*) data->data, data->size))) {
+		goto clean;
+	}
+
+	if (!CHECK ((copy = (GBYTE*) malloc (data->size)) != NULL)) {
+		goto clean;
+	}
+
+	for (t = scan->images, k = 0; k < TARGET; t = t->next, k++);
+
+	for (i = full->images, k = 0; k < TARGET; i = i->next, k++);
+
+	size = data->size;
+
+	CHECK (!i->interlaced && !i->transparent && t->gceoffset > 0);
+
+	// Intact, tolerant or not.
+
+	for (mode = 0; mode < MODES; mode++) {
+		if (CHECK ((gif = CK_DecodeDamaged ((const GBYTE*) data->data, size, GTRUE, mode, &error)) != NULL)) {
+			CK_SameImages (full, gif);
+			GIF_FreeGif (gif);
+		}
+
+		CHECK (error == ERRORNONE);
+	}
+
+	// Cut short halfway through the image data: the rows reached are kept.
+
+	k = t->dataoffset + (t->next->gceoffset - t->dataoffset) / 2;
+
+	if ((gif = CK_Tolerated ((const GBYTE*) data->data, k, full, ERRORTRUNCATED, ERRORTRUNCATED, TARGET + 1, TARGET)) != NULL) {
+		for (j = gif->images; j->next; j = j->next);
+
+		CK_DamagedLike (i, j, i->width);
+		GIF_FreeGif (gif);
+	}
+
+	// Cut short before the image.
+
+	if ((gif = CK_Tolerated ((const GBYTE*) data->data, t->descoffset, full, ERRORTRUNCATED, ERRORTRUNCATED, TARGET, TARGET)) != NULL) {
+		GIF_FreeGif (gif);
+	}
+
+	// A bad code damages its image only.
+
+	memcpy (copy, data->data, size);
+	copy[t->dataoffset] = 0;
+
+	if ((gif = CK_Tolerated (copy, size, full, ERRORBADCODE, ERRORBADCODE, full->imagecount, TARGET)) != NULL) {
+		for (j = gif->images, k = 0; k < TARGET; j = j->next, k++);
+
+		CK_DamagedLike (i, j, 0);
+		CK_SameFirst (i->next, j->next, full->imagecount - TARGET - 1);
+		GIF_FreeGif (gif);
+	}
+
+	// Unknown block, then a graphic control extension without its
+	// terminator.
+
+	memcpy (copy, data->data, size);
+	copy[t->descoffset] = 0x55;
+
+	if ((gif = CK_Tolerated (copy, size, full, ERRORBADBLOCK, ERRORBADBLOCK, TARGET, TARGET)) != NULL) {
+		GIF_FreeGif (gif);
+	}
+
+	memcpy (copy, data->data, size);
+	copy[t->gceoffset + 7] = 1;
+
+	if ((gif = CK_Tolerated (copy, size, full, ERRORBADTERMINATOR, ERRORBADTERMINATOR, TARGET, TARGET)) != NULL) {
+		GIF_FreeGif (gif);
+	}
+
+	// No GIF, or no screen: nothing to keep.
+
+	memcpy (copy, data->data, size);
+	copy[0] = 'X';
+
+	for (mode = 0; mode < MODES; mode++) {
+		CHECK (CK_DecodeDamaged (copy, size, GTRUE, mode, &error) == NULL && error == ERRORNOTGIF);
+		CHECK (CK_DecodeDamaged ((const GBYTE*) data->data, 10, GTRUE, mode, &error) == NULL && error == ERRORTRUNCATED);
+	}
+
+clean:
+	if (copy) {
+		free (copy);
+	}
+
+	if (scan) {
+		GIF_FreeGif (scan);
+	}
+
+	if (full) {
+		GIF_FreeGif (full);
+	}
+
+	if (data) {
+		B_FreeBuffer (data);
+	}
+
+	return GTRUE;
+}
@@ -4,15 +4,8 @@
 #include "sys.h"
 #include "defs.h"
 #include "gif.h"
+#include "palette.h"
 
-#define INTERLACEDSTAGES               4
-
-typedef struct interlaced_s {
-	unsigned int                       startingrow;
-	unsigned char                      increment;
-} interlaced_t;
-
-const interlaced_t INTERLACEDDATA[INTERLACEDSTAGES] = {{0, 8}, {4, 8}, {2, 4}, {1, 2}};
 const char* WINCLASSNAME                            = "GIFTEST";
 const char* WINDOWNAME                              = "GIF TEST";
 
@@ -154,90 +147,35 @@ void M_CleanUp () {
 	}
 }
 
-void M_GetColor (rgb_t* ct, rgb_t* color, GBYTE index) {
-	color->red   = ct[index].red;
-	color->green = ct[index].green;
-	color->blue  = ct[index].blue;
-}
-
-void M_DrawInterlaced (image_t* image, rgb_t* gct, GBOOL bk, BYTE bkidx, unsigned int x, unsigned int y) {
-	unsigned int s, d, j, p, u, v;
-	GBYTE        k;
-	rgb_t        c;
+void M_DrawNormal (image_t* image, rgb_t* gct, UNSIGNED gctsize, GBOOL bk, BYTE bkidx, unsigned int x, unsigned int y) {
+	unsigned int table[256];
+	unsigned int i;
 
-	for (p = 0, s = 0; p < INTERLACEDSTAGES; p++) {
-		for (d = INTERLACEDDATA[p].startingrow; d < image->height; d += INTERLACEDDATA[p].increment, s++) {
-			v = (y + d) * (3 * ScreenWidth + FillSamples) + 3 * x;
-
-			for (j = 0; j < image->width; j++) {
-				u = s * image->width + j;
-				k = ((GBYTE*) (image->indexes->data))[u];
-
-				if (gct) {
-					M_GetColor (gct, &c, k);
-				} else {
-					M_GetColor (image->lct, &c, k);
-				}
+	if (gct) {
+		P_MakeTable (table, gct, gctsize, PIXELBGR, GFALSE, 0);
+	} else {
+		P_MakeTable (table, image->lct, image->lctsize, PIXELBGR, GFALSE, 0);
+	}
 
-				if ((bk && bkidx == k) || !image->transparent || image->trnspindex != k) {
-					Scene[v]     = c.blue;
-					Scene[v + 1] = c.green;
-					Scene[v + 2] = c.red;
-				} else {
-					Scene[v]     = 0;
-					Scene[v + 1] = 0;
-					Scene[v + 2] = 0;
-				}
+	// Transparent pixels are drawn black, unless they are the background.
 
-				v += 3;
-			}
-		}
+	if (image->transparent && !(bk && bkidx == image->trnspindex)) {
+		table[image->trnspindex] = 0;
 	}
-}
-
-void M_DrawNormal (image_t* image, rgb_t* gct, GBOOL bk, BYTE bkidx, unsigned int x, unsigned int y) {
-	unsigned int i, j, u, v;
-	GBYTE        k;
-	rgb_t        c;
 
 	for (i = 0; i < image->height; i++) {
-		v = (y + i) * (3 * ScreenWidth + FillSamples) + 3 * x;
-
-		for (j = 0; j < image->width; j++) {
-			u = i * image->width + j;
-			k = ((GBYTE*) (image->indexes->data))[u];
-
-			if (gct) {
-				M_GetColor (gct, &c, k);
-			} else {
-				M_GetColor (image->lct, &c, k);
-			}
-
-			if ((bk && bkidx == k) || !image->transparent || image->trnspindex != k) {
-				Scene[v]     = c.blue;
-				Scene[v + 1] = c.green;
-				Scene[v + 2] = c.red;
-			} else {
-				Scene[v]     = 0;
-				Scene[v + 1] = 0;
-				Scene[v + 2] = 0;
-			}
-
-			v += 3;
-		}
+		P_ExpandRow (table, (GBYTE*) image->indexes->data + i * image->width, (GBYTE*) Scene + (y + i) * (3 * ScreenWidth + FillSamples) + 3 * x, image->width, PIXELBGR);
 	}
 }
 
-void M_Draw (image_t* image, rgb_t* gct, GBOOL bk, BYTE bkidx, unsigned int x, unsigned int y) {
+void M_Draw (image_t* image, rgb_t* gct, UNSIGNED gctsize, GBOOL bk, BYTE bkidx, unsigned int x, unsigned int y) {
 	if (!image) {
 		return;
 	}
 
-	if (image->interlaced) {
-		M_DrawInterlaced (image, gct, bk, bkidx, x, y);
-	} else {
-		M_DrawNormal (image, gct, bk, bkidx, x, y);
-	}
+	// Interlaced images come from the decoder in raster order too.
+
+	M_DrawNormal (image, gct, gctsize, bk, bkidx, x, y);
 }
 
 void M_Render () {
@@ -269,16 +207,16 @@ void M_BlankScreen () {
 	memset(Scene, 0, (3 * ScreenWidth + FillSamples) * ScreenHeight);
 }
 
-GBOOL M_MoveStreamPointer (long offset) {
-	if (fseek (GIFFile, offset, SEEK_CUR)) {
+GBOOL M_MoveStreamPointer (void* user, long offset) {
+	if (fseek ((FILE*) user, offset, SEEK_CUR)) {
 		return GFALSE;
 	}
 
 	return GTRUE;
 }
 
-GBOOL M_ReadStream (void* ptr, unsigned long count) {
-	return fread(ptr, sizeof (GBYTE), count, GIFFile) == count * sizeof (GBYTE);
+GBOOL M_ReadStream (void* user, void* ptr, unsigned long count) {
+	return fread(ptr, sizeof (GBYTE), count, (FILE*) user) == count * sizeof (GBYTE);
 }
 
 int WINAPI WinMain (HINSTANCE hThisInstance, HINSTANCE hPrevInstance, LPSTR lpszArgument, int nCmdShow) {
@@ -302,7 +240,7 @@ int WINAPI WinMain (HINSTANCE hThisInstance, HINSTANCE hPrevInstance, LPSTR lpsz
 			goto clean2;
 		}
 
-		if (!GIF_ProcessStream (&gif, &M_ReadStream, &M_MoveStreamPointer)) {
+		if (!GIF_ProcessStream (&gif, &M_ReadStream, &M_MoveStreamPointer, GIFFile)) {
 			goto clean;
 		}
 
@@ -341,10 +279,10 @@ int WINAPI WinMain (HINSTANCE hThisInstance, HINSTANCE hPrevInstance, LPSTR lpsz
 					totaltime = 0;
 				}
 
-				M_Draw (i, gif->gct, gif->background, gif->bkgindex, i->left, i->top);
+				M_Draw (i, gif->gct, gif->gctsize, gif->background, gif->bkgindex, i->left, i->top);
 			} else {
 				while (i) {
-					M_Draw (i, gif->gct, gif->background, gif->bkgindex, i->left, i->top);
+					M_Draw (i, gif->gct, gif->gctsize, gif->background, gif->bkgindex, i->left, i->top);
 					i = i->next;
 				}
 			}